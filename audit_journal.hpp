@@ -0,0 +1,351 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tscns.hpp"
+
+namespace tscns {
+
+struct AuditRecord
+{
+    static constexpr int32_t Calibration = 1;
+    static constexpr int32_t Checkpoint = 2;
+
+    int32_t kind;
+    int32_t calib_kind;
+    // CalibKind of a calibration record
+    int64_t seq;
+    // index in the journal
+    int64_t sys_ns;
+    // UTC time of the calibration, as read from the reference clock
+    int64_t tsc;
+    int64_t ns_err;
+    // how far TSCNS was off the reference clock when it calibrated
+    double ns_per_tsc;
+    int64_t uncertainty_ns;
+    // how precisely the reference clock was sampled: half the syncTime() bracket
+    uint64_t mac;
+    // checkpoint only: SipHash-2-4 of every byte from the previous checkpoint up to this one
+};
+
+struct AuditHeader
+{
+    static constexpr uint64_t FileMagic = 0x314c4e524a445541;
+    // "AUDJRNL1" in little endian
+    static constexpr size_t Size = 4096;
+
+    uint64_t magic;
+    uint32_t record_size;
+    uint32_t checkpoint_interval;
+    uint64_t capacity;
+    std::atomic<uint64_t> count;
+    // records written, published after each record so the journal can be read while being written
+    char source[64];
+    // reference clock the calibrations sync to, e.g. "CLOCK_REALTIME, chrony to GPS PPS"
+    uint64_t sealed_count;
+    uint64_t seal;
+    // records up to the last checkpoint, and the keyed hash of that count with the checkpoint's mac: cutting records
+    // off the tail, trailing checkpoints included, leaves fewer records than sealed
+};
+
+// SipHash-2-4 with a 128 bit key, the keyed hash sealing the checkpoints
+inline uint64_t sipHash24(const uint64_t key[2], const void * data, size_t len)
+{
+    auto rotl = [](uint64_t x, int b) { return (x << b) | (x >> (64 - b)); };
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0], v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0], v3 = 0x7465646279746573ULL ^ key[1];
+    auto round = [&]() {
+        v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+        v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+    };
+    const uint8_t * p = static_cast<const uint8_t *>(data);
+    size_t blocks = len / 8;
+    for(size_t i = 0; i < blocks; i++)
+    {
+        uint64_t m;
+        memcpy(&m, p + i * 8, 8);
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    }
+    uint64_t last = static_cast<uint64_t>(len) << 56;
+    for(size_t i = 0; i < len % 8; i++)
+    {
+        last |= static_cast<uint64_t>(p[blocks * 8 + i]) << (8 * i);
+    }
+    v3 ^= last;
+    round();
+    round();
+    v0 ^= last;
+    v2 ^= 0xff;
+    round();
+    round();
+    round();
+    round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/**
+ * @brief Append-only, memory mapped journal of the calibrations of a TSCNS, to demonstrate its divergence from UTC
+ * after the fact (MiFID II RTS 25 style), see audit_report.cc.
+ * Every calibration appends the offset found, the new slope and the sampling uncertainty; every checkpoint_interval
+ * records a checkpoint seals everything since the previous one with a keyed hash, and the header seals the number of
+ * records up to the last checkpoint, so records can't be altered or removed without the key. Records after the last
+ * checkpoint aren't sealed yet: close() writes a checkpoint. It's a MAC rather than a public key signature: the
+ * auditor needs the key to verify.
+ *
+ * Records are written by the calibrating thread through the calibration hook, outside of the seqlock, so rdns()
+ * readers never wait for the journal. That thread can hit ftruncate(), mremap and msync(), so the journal requires a
+ * dedicated calibrating thread, off the hot path: a self-calibrating clock (kSelfCalibrate), whose hook runs in
+ * whichever rdns() caller finds calibration due, is rejected at compile time, and calibrateStep() must only be called
+ * by threads that can afford the journal too. POSIX only.
+ */
+class AuditJournal
+{
+public:
+    ~AuditJournal() { close(); }
+    bool open(const char * path, const uint64_t key[2], const char * source, uint32_t checkpoint_interval = 60,
+              uint64_t initial_capacity = 1 << 16);
+    void close();
+    template <typename Clock>
+    void attach(Clock & clock, CalibHook next = nullptr, void * next_ctx = nullptr);
+    void append(const CalibRecord & record);
+    void checkpoint();
+    static void hook(void * ctx, const CalibRecord & record);
+
+    static uint64_t checkpointMac(const uint64_t key[2], const AuditRecord * records, uint64_t from, uint64_t to);
+    static uint64_t headerSeal(const uint64_t key[2], uint64_t sealed_count, uint64_t last_mac);
+
+private:
+    bool map(uint64_t capacity);
+    AuditRecord * records() { return reinterpret_cast<AuditRecord *>(static_cast<char *>(base_) + AuditHeader::Size); }
+    AuditHeader * header() { return static_cast<AuditHeader *>(base_); }
+
+    int fd_ = -1;
+    void * base_ = nullptr;
+    size_t map_len_ = 0;
+    uint64_t key_[2] = {0, 0};
+    uint64_t last_checkpoint_ = 0;
+    uint32_t since_checkpoint_ = 0;
+    CalibHook next_ = nullptr;
+    void * next_ctx_ = nullptr;
+};
+
+inline bool AuditJournal::map(uint64_t capacity)
+{
+    size_t len = AuditHeader::Size + capacity * sizeof(AuditRecord);
+    if(ftruncate(fd_, len) != 0)
+    {
+        return false;
+    }
+    if(base_)
+    {
+        munmap(base_, map_len_);
+    }
+    base_ = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if(base_ == MAP_FAILED)
+    {
+        base_ = nullptr;
+        return false;
+    }
+    map_len_ = len;
+    header()->capacity = capacity;
+    return true;
+}
+
+// Opens an existing journal to append to it, or creates one. Anything else than an empty file or a journal is left
+// untouched: the header is checked before the file gets resized or mapped.
+inline bool AuditJournal::open(const char * path, const uint64_t key[2], const char * source,
+                               uint32_t checkpoint_interval, uint64_t initial_capacity)
+{
+    close();
+    key_[0] = key[0];
+    key_[1] = key[1];
+    fd_ = ::open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if(fd_ < 0 || fstat(fd_, &st) != 0)
+    {
+        close();
+        return false;
+    }
+    bool fresh = st.st_size == 0;
+    uint64_t capacity = initial_capacity;
+    if(!fresh)
+    {
+        uint64_t magic = 0, count = 0;
+        uint32_t record_size = 0;
+        bool ok = static_cast<size_t>(st.st_size) >= AuditHeader::Size &&
+                  pread(fd_, &magic, sizeof(magic), offsetof(AuditHeader, magic)) == sizeof(magic) &&
+                  pread(fd_, &record_size, sizeof(record_size), offsetof(AuditHeader, record_size)) ==
+                      sizeof(record_size) &&
+                  pread(fd_, &count, sizeof(count), offsetof(AuditHeader, count)) == sizeof(count);
+        capacity = ok ? (st.st_size - AuditHeader::Size) / sizeof(AuditRecord) : 0;
+        if(!ok || magic != AuditHeader::FileMagic || record_size != sizeof(AuditRecord) || count > capacity ||
+           capacity == 0)
+        {
+            close();
+            return false;
+        }
+    }
+    if(!map(capacity))
+    {
+        close();
+        return false;
+    }
+    AuditHeader * h = header();
+    if(fresh)
+    {
+        h->magic = AuditHeader::FileMagic;
+        h->record_size = sizeof(AuditRecord);
+        h->count.store(0, std::memory_order_relaxed);
+        strncpy(h->source, source, sizeof(h->source) - 1);
+        h->sealed_count = 0;
+        h->seal = headerSeal(key_, 0, 0);
+    }
+    h->checkpoint_interval = checkpoint_interval;
+    // find where the last session left off, records after its last checkpoint get sealed by our first one
+    last_checkpoint_ = 0;
+    uint64_t count = h->count.load(std::memory_order_relaxed);
+    for(uint64_t i = count; i > 0; i--)
+    {
+        if(records()[i - 1].kind == AuditRecord::Checkpoint)
+        {
+            last_checkpoint_ = i - 1;
+            break;
+        }
+    }
+    since_checkpoint_ = 0;
+    return true;
+}
+
+inline void AuditJournal::close()
+{
+    if(base_)
+    {
+        if(since_checkpoint_)
+        {
+            checkpoint();
+        }
+        msync(base_, map_len_, MS_SYNC);
+        munmap(base_, map_len_);
+        base_ = nullptr;
+    }
+    if(fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+// Journal every calibration of clock from now on, and still pass them to next if there's another hook to feed
+template <typename Clock>
+void AuditJournal::attach(Clock & clock, CalibHook next, void * next_ctx)
+{
+    static_assert(!Clock::SelfCalibrate, "the journal needs a dedicated calibrating thread, not rdns() callers");
+    next_ = next;
+    next_ctx_ = next_ctx;
+    clock.setCalibHook(&AuditJournal::hook, this);
+}
+
+inline void AuditJournal::hook(void * ctx, const CalibRecord & record)
+{
+    AuditJournal * self = static_cast<AuditJournal *>(ctx);
+    self->append(record);
+    if(self->next_)
+    {
+        self->next_(self->next_ctx_, record);
+    }
+}
+
+inline void AuditJournal::append(const CalibRecord & record)
+{
+    if(!base_ || record.kind == CalibInitBase)
+    {
+        // the first sample of init() decides nothing, the second one carries the decision
+        return;
+    }
+    AuditHeader * h = header();
+    uint64_t count = h->count.load(std::memory_order_relaxed);
+    if(count == h->capacity && !map(h->capacity * 2))
+    {
+        return;
+    }
+    AuditRecord & r = records()[count];
+    r = AuditRecord {AuditRecord::Calibration, static_cast<int32_t>(record.kind), static_cast<int64_t>(count),
+                     record.sys_ns, record.tsc, record.ns_err, record.ns_per_tsc,
+                     static_cast<int64_t>(record.bracket_tsc * record.ns_per_tsc / 2), 0};
+    header()->count.store(count + 1, std::memory_order_release);
+    if(++since_checkpoint_ >= h->checkpoint_interval)
+    {
+        checkpoint();
+    }
+}
+
+// Seal every record since the previous checkpoint, and ask the kernel to write them out
+inline void AuditJournal::checkpoint()
+{
+    AuditHeader * h = header();
+    uint64_t count = h->count.load(std::memory_order_relaxed);
+    if(count == h->capacity && !map(h->capacity * 2))
+    {
+        return;
+    }
+    AuditRecord & r = records()[count];
+    const AuditRecord & prev = records()[count ? count - 1 : 0];
+    r = AuditRecord {AuditRecord::Checkpoint, 0, static_cast<int64_t>(count), prev.sys_ns, prev.tsc, 0, 0.0, 0, 0};
+    r.mac = checkpointMac(key_, records(), last_checkpoint_, count);
+    header()->count.store(count + 1, std::memory_order_release);
+    header()->sealed_count = count + 1;
+    header()->seal = headerSeal(key_, count + 1, r.mac);
+    last_checkpoint_ = count;
+    since_checkpoint_ = 0;
+    msync(base_, map_len_, MS_ASYNC);
+}
+
+// MAC of records [from, to], the one at to being the checkpoint itself (its mac field excluded). Starting from the
+// previous checkpoint chains the checkpoints together.
+inline uint64_t AuditJournal::checkpointMac(const uint64_t key[2], const AuditRecord * records, uint64_t from,
+                                            uint64_t to)
+{
+    return sipHash24(key, records + from, (to - from) * sizeof(AuditRecord) + offsetof(AuditRecord, mac));
+}
+
+// Seal of the header: the number of records up to the last checkpoint, bound to that checkpoint's mac
+inline uint64_t AuditJournal::headerSeal(const uint64_t key[2], uint64_t sealed_count, uint64_t last_mac)
+{
+    const uint64_t data[2] = {sealed_count, last_mac};
+    return sipHash24(key, data, sizeof(data));
+}
+
+}
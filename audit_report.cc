@@ -0,0 +1,270 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include "audit_journal.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage:
+//   audit_report record journal_file key_hex seconds [calibrate_interval_ms]
+//     run a clock calibrating every calibrate_interval_ms (1000 by default) and audit every calibration
+//   audit_report report journal_file key_hex
+//     verify the checkpoints of a journal and report, per UTC day, the max divergence of the clock from the reference
+//   audit_report selftest journal_file
+//     journal calibrations with known offsets, up to 50 ms, into journal_file and check the report finds them, then
+//     that cutting records off the tail of the journal is detected
+// key_hex is the 128 bit checkpoint key, as 32 hex digits.
+
+static bool parseKey(const char* hex, uint64_t key[2]) {
+  if (strlen(hex) != 32) return false;
+  for (int i = 0; i < 2; i++) {
+    key[i] = 0;
+    for (int j = 0; j < 16; j++) {
+      char c = hex[i * 16 + j];
+      int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+      if (d < 0) return false;
+      key[i] = key[i] << 4 | d;
+    }
+  }
+  return true;
+}
+
+static int record(const char* path, const uint64_t key[2], int64_t seconds, int64_t interval_ms) {
+  tscns::AuditJournal journal;
+  if (!journal.open(path, key, "CLOCK_REALTIME")) {
+    cerr << "can't open " << path << endl;
+    return 1;
+  }
+  tscns::TSCNS<> tn;
+  journal.attach(tn);
+  tn.init(20'000'000, interval_ms * 1'000'000);
+  int64_t end = tn.rdns() + seconds * tscns::TSCNS<>::NsPerSec;
+  while (tn.rdns() < end) {
+    tn.calibrate();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  journal.close();
+  return 0;
+}
+
+struct DayStats {
+  int64_t calibrations = 0;
+  int64_t max_err = 0;
+  int64_t max_err_ns = 0;
+  // sys_ns of the max error
+  int64_t max_uncertainty = 0;
+  int64_t max_divergence = 0;
+  // bound on |clock - reference|: |ns_err| plus the uncertainty of the reference sample
+  double min_ghz = 1e9, max_ghz = 0;
+};
+
+static string utcDate(int64_t ns) {
+  time_t t = ns / tscns::TSCNS<>::NsPerSec;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char buf[32];
+  strftime(buf, sizeof(buf), "%Y-%m-%d", &tm);
+  return buf;
+}
+
+static string utcTime(int64_t ns) {
+  time_t t = ns / tscns::TSCNS<>::NsPerSec;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char buf[32];
+  strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+  return string(buf) + "." + to_string(ns % tscns::TSCNS<>::NsPerSec + tscns::TSCNS<>::NsPerSec).substr(1);
+}
+
+struct Report {
+  string source;
+  uint64_t count = 0, sealed = 0, bad = 0;
+  map<string, DayStats> days;
+};
+
+static bool analyze(const char* path, const uint64_t key[2], Report& rep) {
+  ifstream in(path, ios::binary);
+  tscns::AuditHeader header;
+  if (!in.read((char*)&header, sizeof(header)) || header.magic != tscns::AuditHeader::FileMagic ||
+      header.record_size != sizeof(tscns::AuditRecord)) {
+    cerr << "not an audit journal: " << path << endl;
+    return false;
+  }
+  rep.source = string(header.source, strnlen(header.source, sizeof(header.source)));
+  rep.count = header.count.load();
+  vector<tscns::AuditRecord> records(rep.count);
+  in.seekg(tscns::AuditHeader::Size);
+  if (!in.read((char*)records.data(), rep.count * sizeof(tscns::AuditRecord))) {
+    cerr << "truncated journal" << endl;
+    return false;
+  }
+
+  // every record must be sealed by a checkpoint whose mac matches, in a chain from the first record
+  uint64_t prev = 0;
+  for (uint64_t i = 0; i < rep.count; i++) {
+    if (records[i].seq != (int64_t)i) {
+      cout << "record " << i << " out of sequence" << endl;
+      rep.bad++;
+    }
+    if (records[i].kind != tscns::AuditRecord::Checkpoint) continue;
+    if (tscns::AuditJournal::checkpointMac(key, records.data(), prev, i) != records[i].mac) {
+      cout << "checkpoint " << i << " doesn't verify: records " << prev << " to " << i << " altered" << endl;
+      rep.bad++;
+    }
+    prev = i;
+    rep.sealed = i + 1;
+  }
+  // the header seals how many records there were at the last checkpoint: fewer left means the tail was cut off
+  uint64_t last_mac = rep.sealed ? records[rep.sealed - 1].mac : 0;
+  if (header.sealed_count != rep.sealed || tscns::AuditJournal::headerSeal(key, rep.sealed, last_mac) != header.seal) {
+    cout << "header seals " << header.sealed_count << " records, the last checkpoint verified seals " << rep.sealed
+         << ": records removed or header altered" << endl;
+    rep.bad++;
+  }
+
+  for (uint64_t i = 0; i < rep.sealed; i++) {
+    auto& r = records[i];
+    if (r.kind != tscns::AuditRecord::Calibration) continue;
+    auto& d = rep.days[utcDate(r.sys_ns)];
+    int64_t err = std::abs(r.ns_err);
+    d.calibrations++;
+    if (err > d.max_err) {
+      d.max_err = err;
+      d.max_err_ns = r.sys_ns;
+    }
+    d.max_uncertainty = max(d.max_uncertainty, r.uncertainty_ns);
+    d.max_divergence = max(d.max_divergence, err + r.uncertainty_ns);
+    d.min_ghz = min(d.min_ghz, 1.0 / r.ns_per_tsc);
+    d.max_ghz = max(d.max_ghz, 1.0 / r.ns_per_tsc);
+  }
+  return true;
+}
+
+static int report(const char* path, const uint64_t key[2]) {
+  Report rep;
+  if (!analyze(path, key, rep)) return 1;
+  cout << "reference: " << rep.source << ", timestamp granularity: 1 ns, records: " << rep.count
+       << ", sealed: " << rep.sealed << ", checkpoint failures: " << rep.bad << endl;
+  for (auto& [day, d] : rep.days) {
+    cout << day << ": calibrations: " << d.calibrations << ", max |offset| ns: " << d.max_err << " at "
+         << utcTime(d.max_err_ns) << ", max uncertainty ns: " << d.max_uncertainty
+         << ", max divergence ns: " << d.max_divergence << ", tsc ghz: " << std::setprecision(9) << fixed << d.min_ghz
+         << " - " << d.max_ghz << endl;
+  }
+  if (rep.sealed < rep.count) cout << "warning: last " << rep.count - rep.sealed << " records not sealed by a checkpoint" << endl;
+  return rep.bad ? 2 : 0;
+}
+
+static bool isCheckpoint(const char* path, uint64_t i) {
+  ifstream in(path, ios::binary);
+  tscns::AuditRecord r;
+  in.seekg(tscns::AuditHeader::Size + i * sizeof(r));
+  return in.read((char*)&r, sizeof(r)) && r.kind == tscns::AuditRecord::Checkpoint;
+}
+
+// Journals calibrations made from synthetic samples, with offsets of known size from the reference, and checks the
+// report finds them as they are: in particular those over the 1 ms a single calibration corrects.
+static int selftest(const char* path) {
+  const uint64_t key[2] = {0x0123456789abcdefULL, 0xfedcba9876543210ULL};
+  const int64_t t0 = 1'700'000'000'000'000'000;
+  // 2023-11-14T22:13:20Z
+  const int64_t offsets[] = {200'000, -3'000'000, 50'000'000, 700};
+  unlink(path);
+  {
+    tscns::AuditJournal journal;
+    if (!journal.open(path, key, "selftest", 2)) {
+      cerr << "can't open " << path << endl;
+      return 1;
+    }
+    tscns::TSCNS<> tn;
+    journal.attach(tn);
+    // a 2 GHz tsc, sampled within 100 tsc
+    tn.initWithSamples(tscns::TSCNS<>::NsPerSec, 1'000'000'000, t0, 100, 3'000'000'000, t0 + 1'000'000'000, 100);
+    int64_t tsc = 3'000'000'000;
+    for (int64_t offset : offsets) {
+      tsc += 2'000'000'000;
+      tn.calibrateWithSample(tsc, tn.tsc2ns(tsc) - offset, 100);
+    }
+  }
+  Report rep;
+  if (!analyze(path, key, rep)) return 1;
+  int64_t expected = 0;
+  for (int64_t offset : offsets) expected = max(expected, std::abs(offset));
+  auto& d = rep.days.begin()->second;
+  bool ok = rep.bad == 0 && rep.sealed == rep.count && rep.days.size() == 1 && d.calibrations == 5 &&
+            d.max_err == expected && d.max_divergence > expected;
+  // 5 calibrations: init and the samples
+  cout << "max |offset| ns: " << d.max_err << " (expected " << expected << "), max divergence ns: " << d.max_divergence
+       << ", calibrations: " << d.calibrations << ", checkpoint failures: " << rep.bad << (ok ? ", ok" : ", FAILED")
+       << endl;
+
+  // cut the tail off at an earlier checkpoint, fixing up the record count: every remaining checkpoint still verifies,
+  // the header seal must not
+  uint64_t cut = rep.count - 1;
+  while (cut > 0 && !isCheckpoint(path, cut - 1)) cut--;
+  {
+    fstream f(path, ios::in | ios::out | ios::binary);
+    f.seekp(offsetof(tscns::AuditHeader, count));
+    f.write((const char*)&cut, sizeof(cut));
+  }
+  truncate(path, tscns::AuditHeader::Size + cut * sizeof(tscns::AuditRecord));
+  Report cut_rep;
+  bool detected = cut > 0 && analyze(path, key, cut_rep) && cut_rep.bad > 0;
+  cout << "tail cut from " << rep.count << " to " << cut << " records: " << (detected ? "detected, ok" : "FAILED")
+       << endl;
+  unlink(path);
+  return ok && detected ? 0 : 1;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_audit_report_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  uint64_t key[2];
+  if (argc >= 5 && strcmp(argv[1], "record") == 0 && parseKey(argv[3], key)) {
+    return record(argv[2], key, stoll(argv[4]), argc > 5 ? stoll(argv[5]) : 1000);
+  }
+  if (argc >= 4 && strcmp(argv[1], "report") == 0 && parseKey(argv[3], key)) {
+    return report(argv[2], key);
+  }
+  if (argc >= 3 && strcmp(argv[1], "selftest") == 0) {
+    return selftest(argv[2]);
+  }
+  cerr << "usage: " << argv[0] << " record journal_file key_hex seconds [calibrate_interval_ms]" << endl
+       << "       " << argv[0] << " report journal_file key_hex" << endl
+       << "       " << argv[0] << " selftest journal_file" << endl;
+  return 1;
+}
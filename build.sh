@@ -1 +1,28 @@
 g++ -Ofast -Wall tscns_test.cc -o tscns_test
+g++ -Ofast -Wall hlc_bench.cc -o hlc_bench -pthread
+g++ -Ofast -Wall idgen_bench.cc -o idgen_bench -pthread
+g++ -Ofast -Wall jitter_meter.cc -o jitter_meter -pthread
+g++ -Ofast -Wall reorder_bench.cc -o reorder_bench -pthread
+g++ -Ofast -Wall kway_merge_bench.cc -o kway_merge_bench -pthread
+g++ -Ofast -Wall tsclog_bench.cc -o tsclog_bench -pthread
+g++ -O2 -Wall tsclog_decompress.cc -o tsclog_decompress
+g++ -O2 -Wall tsc_convert.cc -o tsc_convert -pthread
+g++ -O2 -Wall calib_replay.cc -o calib_replay -pthread
+g++ -O2 -Wall audit_report.cc -o audit_report -pthread
+g++ -Ofast -Wall replay_bench.cc -o replay_bench
+g++ -Ofast -Wall pcapng_bench.cc -o pcapng_bench -pthread
+g++ -Ofast -Wall kernel_ts_bench.cc -o kernel_ts_bench -pthread
+g++ -O2 -Wall offset_probe.cc -o offset_probe -pthread -lrt
+g++ -O2 -Wall latency_map.cc -o latency_map -pthread
+g++ -O2 -Wall latency_tag_test.cc -o latency_tag_test
+g++ -O2 -Wall watchdog_test.cc -o watchdog_test
+g++ -O2 -Wall seqlock_bench.cc -o seqlock_bench -pthread
+g++ -O2 -Wall seqlock_stress.cc -o seqlock_stress -pthread
+g++ -O1 -g -Wall -fsanitize=thread tscns_tsan_stress.cc -o tscns_tsan_stress -pthread
+./tscns_tsan_stress 1 2 broken > /dev/null 2>&1; [ $? -eq 66 ] || echo "tscns_tsan_stress: TSAN missed the race of the broken mode"
+g++ -O2 -Wall latency_guard.cc -o latency_guard -pthread
+g++ -O2 -Wall -shared -fPIC -fvisibility=hidden tscns_global.cc -o libtscns_global.so
+g++ -O2 -Wall -shared -fPIC -fvisibility=hidden tscns_global_plugin.cc -o libtscns_global_plugin_a.so -L. -ltscns_global -Wl,-rpath,'$ORIGIN'
+g++ -O2 -Wall -shared -fPIC -fvisibility=hidden tscns_global_plugin.cc -o libtscns_global_plugin_b.so -L. -ltscns_global -Wl,-rpath,'$ORIGIN'
+g++ -O2 -Wall tscns_global_demo.cc -o tscns_global_demo -L. -ltscns_global -Wl,-rpath,'$ORIGIN' -ldl
+gcc -O2 -Wall tscns_c_demo.c -o tscns_c_demo -L. -ltscns_global -Wl,-rpath,'$ORIGIN'
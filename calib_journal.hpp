@@ -0,0 +1,118 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdio>
+#include <vector>
+#include "tscns.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Binary journal of every calibration a TSCNS makes: the system clock sample and the parameters saved, as
+ * CalibRecords. Meant to collect field data to compare calibration algorithms on, see calib_replay.cc.
+ * Appending is a fwrite() into the stdio buffer from the calibrating thread, the hot path is not involved.
+ */
+class CalibJournal
+{
+public:
+    static constexpr uint64_t FileMagic = 0x314c4e524a424c43;
+    // "CLBJRNL1" in little endian
+
+    ~CalibJournal() { close(); }
+    bool open(const char * path);
+    void close();
+    void flush();
+    template <typename Clock>
+    void attach(Clock & clock) { clock.setCalibHook(&CalibJournal::hook, this); }
+    void append(const CalibRecord & record);
+    static void hook(void * ctx, const CalibRecord & record) { static_cast<CalibJournal *>(ctx)->append(record); }
+
+    static bool read(const char * path, std::vector<CalibRecord> & records);
+
+private:
+    FILE * file_ = nullptr;
+};
+
+// Appends to an existing journal, or creates a new one
+inline bool CalibJournal::open(const char * path)
+{
+    close();
+    file_ = fopen(path, "ab");
+    if(!file_)
+    {
+        return false;
+    }
+    // the position of a file opened for appending is unspecified until the first write
+    if(fseek(file_, 0, SEEK_END) == 0 && ftell(file_) == 0)
+    {
+        fwrite(&FileMagic, sizeof(FileMagic), 1, file_);
+    }
+    return true;
+}
+
+inline void CalibJournal::close()
+{
+    if(file_)
+    {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+inline void CalibJournal::flush()
+{
+    if(file_)
+    {
+        fflush(file_);
+    }
+}
+
+inline void CalibJournal::append(const CalibRecord & record)
+{
+    if(file_)
+    {
+        fwrite(&record, sizeof(record), 1, file_);
+    }
+}
+
+inline bool CalibJournal::read(const char * path, std::vector<CalibRecord> & records)
+{
+    FILE * f = fopen(path, "rb");
+    if(!f)
+    {
+        return false;
+    }
+    uint64_t magic = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, f) == 1 && magic == FileMagic;
+    CalibRecord record;
+    while(ok && fread(&record, sizeof(record), 1, f) == 1)
+    {
+        records.push_back(record);
+    }
+    fclose(f);
+    return ok;
+}
+
+}
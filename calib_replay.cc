@@ -0,0 +1,208 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include "calib_journal.hpp"
+#include "histogram.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage:
+//   calib_replay record journal_file seconds [calibrate_interval_ms]
+//     run a clock calibrating every calibrate_interval_ms (1000 by default) and journal every calibration
+//   calib_replay replay journal_file
+//     feed a journal (possibly from days on a production host) through several calibrators at full speed, and compare
+//     the error each one had at every sample, i.e. how far its clock was off the system clock right before it
+//     calibrated.
+
+// A calibration algorithm to evaluate: told about every recorded sample, predicts the ns of a tsc in between
+class Calibrator {
+ public:
+  virtual ~Calibrator() {}
+  virtual const char* name() const = 0;
+  virtual void init(const tscns::CalibRecord& base, const tscns::CalibRecord& delayed) = 0;
+  virtual void calibrate(const tscns::CalibRecord& sample) = 0;
+  virtual int64_t tsc2ns(int64_t tsc) const = 0;
+};
+
+// What TSCNS does
+class TscnsCalibrator : public Calibrator {
+ public:
+  const char* name() const override { return "tscns"; }
+  void init(const tscns::CalibRecord& base, const tscns::CalibRecord& delayed) override {
+    tn_.initWithSamples(delayed.calibrate_interval_ns, base.tsc, base.sys_ns, base.bracket_tsc, delayed.tsc,
+                        delayed.sys_ns, delayed.bracket_tsc);
+  }
+  void calibrate(const tscns::CalibRecord& sample) override {
+    tn_.calibrateWithSample(sample.tsc, sample.sys_ns, sample.bracket_tsc);
+  }
+  int64_t tsc2ns(int64_t tsc) const override { return tn_.tsc2ns(tsc); }
+
+ private:
+  tscns::TSCNS<> tn_;
+};
+
+// Baseline: never calibrate after init
+class InitOnlyCalibrator : public Calibrator {
+ public:
+  const char* name() const override { return "init_only"; }
+  void init(const tscns::CalibRecord& base, const tscns::CalibRecord& delayed) override {
+    param_ = {base.tsc, base.sys_ns, (double)(delayed.sys_ns - base.sys_ns) / (delayed.tsc - base.tsc)};
+  }
+  void calibrate(const tscns::CalibRecord&) override {}
+  int64_t tsc2ns(int64_t tsc) const override { return param_.tsc2ns(tsc); }
+
+ private:
+  tscns::TscParam param_;
+};
+
+// Least squares line through the last kWindow samples. It jumps at each calibration, unlike TSCNS which stays
+// continuous, so it's an accuracy reference rather than a usable clock.
+class LeastSquaresCalibrator : public Calibrator {
+ public:
+  static constexpr size_t kWindow = 16;
+  const char* name() const override { return "lsq16"; }
+  void init(const tscns::CalibRecord& base, const tscns::CalibRecord& delayed) override {
+    samples_.clear();
+    samples_.push_back(base);
+    calibrate(delayed);
+  }
+  void calibrate(const tscns::CalibRecord& sample) override {
+    samples_.push_back(sample);
+    if (samples_.size() > kWindow) samples_.pop_front();
+    // fit relative to the first sample to keep the doubles precise
+    const auto& o = samples_.front();
+    double n = samples_.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (auto& s : samples_) {
+      double x = s.tsc - o.tsc, y = s.sys_ns - o.sys_ns;
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+    }
+    double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    double intercept = (sy - slope * sx) / n;
+    param_ = {o.tsc, o.sys_ns + (int64_t)intercept, slope};
+  }
+  int64_t tsc2ns(int64_t tsc) const override { return param_.tsc2ns(tsc); }
+
+ private:
+  deque<tscns::CalibRecord> samples_;
+  tscns::TscParam param_;
+};
+
+static int record(const char* path, int64_t seconds, int64_t interval_ms) {
+  tscns::TSCNS<> tn;
+  tscns::CalibJournal journal;
+  if (!journal.open(path)) {
+    cerr << "failed to open " << path << endl;
+    return 1;
+  }
+  journal.attach(tn);
+  tn.init(20'000'000, interval_ms * 1'000'000);
+  int64_t expire = tn.rdns() + seconds * tn.NsPerSec;
+  int64_t calibrations = 0;
+  while (tn.rdns() < expire) {
+    tn.calibrate();
+    std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms / 10 + 1));
+    if (++calibrations % 100 == 0) journal.flush();
+  }
+  journal.close();
+  cout << "journal written to " << path << endl;
+  return 0;
+}
+
+static int replay(const char* path) {
+  vector<tscns::CalibRecord> records;
+  if (!tscns::CalibJournal::read(path, records)) {
+    cerr << "failed to read journal " << path << endl;
+    return 1;
+  }
+  vector<unique_ptr<Calibrator>> calibrators;
+  calibrators.emplace_back(new TscnsCalibrator);
+  calibrators.emplace_back(new InitOnlyCalibrator);
+  calibrators.emplace_back(new LeastSquaresCalibrator);
+  vector<tscns::Histogram<>> errors(calibrators.size());
+
+  int64_t replayed = 0, reproduced = 0;
+  bool initialized = false;
+  tscns::CalibRecord base{};
+  int64_t t0 = tscns::TSCNS<>::rdsysns();
+  for (auto& rec : records) {
+    if (rec.kind == tscns::CalibInitBase) {
+      base = rec;
+      continue;
+    }
+    if (rec.kind == tscns::CalibInit) {
+      // a journal can hold several runs, each starts over from its own init
+      for (auto& c : calibrators) c->init(base, rec);
+      initialized = true;
+      continue;
+    }
+    if (!initialized) continue;
+    for (size_t i = 0; i < calibrators.size(); i++) {
+      int64_t err = calibrators[i]->tsc2ns(rec.tsc) - rec.sys_ns;
+      errors[i].record(std::abs(err));
+      if (i == 0) reproduced += err == rec.ns_err;
+      calibrators[i]->calibrate(rec);
+    }
+    replayed++;
+  }
+  int64_t t1 = tscns::TSCNS<>::rdsysns();
+
+  cout << "samples: " << replayed << ", replay ns/sample: " << std::setprecision(3) << fixed
+       << (double)(t1 - t0) / max(replayed, int64_t(1)) << ", tscns decisions reproduced: " << reproduced << endl;
+  for (size_t i = 0; i < calibrators.size(); i++) {
+    auto& h = errors[i];
+    cout << calibrators[i]->name() << ": |err| ns mean: " << h.mean() << ", p50: " << h.percentile(50)
+         << ", p99: " << h.percentile(99) << ", max: " << h.max() << endl;
+  }
+  return 0;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_calib_replay_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  if (argc >= 4 && strcmp(argv[1], "record") == 0) {
+    return record(argv[2], stoll(argv[3]), argc > 4 ? stoll(argv[4]) : 1000);
+  }
+  if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+    return replay(argv[2]);
+  }
+  cerr << "usage: " << argv[0] << " record journal_file seconds [calibrate_interval_ms]" << endl
+       << "       " << argv[0] << " replay journal_file" << endl;
+  return 1;
+}
@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <ctime>
+#include "tscns.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Translates kernel timestamps (CLOCK_REALTIME, e.g. SO_TIMESTAMPNS / SO_TIMESTAMPING software stamps, or
+ * CLOCK_MONOTONIC) into the timeline of a TSCNS clock and back, so they can be subtracted from rdns() stamps.
+ * rdns() and the system clock differ by the offset the last calibration found, which the clock cancels
+ * progressively (see TSCNS::sysOffset()); the translation adds or removes that offset at the time of the timestamp.
+ * CLOCK_MONOTONIC goes through CLOCK_REALTIME with the difference sampled by refresh(): call it after each
+ * calibration, as that difference changes whenever the system clock is stepped. POSIX only.
+ */
+template <typename Clock = TSCNS<>>
+class ClockMap
+{
+public:
+    explicit ClockMap(const Clock & clock)
+        : clock_(clock)
+    {
+        refresh();
+    }
+    void refresh();
+
+    int64_t fromRealtime(int64_t ns) const { return ns + clock_.sysOffset(ns2tsc(ns)); }
+    int64_t toRealtime(int64_t ns) const { return ns - clock_.sysOffset(ns2tsc(ns)); }
+    int64_t fromMonotonic(int64_t ns) const { return fromRealtime(ns + realtimeMinusMonotonic()); }
+    int64_t toMonotonic(int64_t ns) const { return toRealtime(ns) - realtimeMinusMonotonic(); }
+    int64_t fromTimespec(const timespec & ts) const { return fromRealtime(ts.tv_sec * Clock::NsPerSec + ts.tv_nsec); }
+
+private:
+    int64_t realtimeMinusMonotonic() const { return realtime_minus_monotonic_.load(std::memory_order_relaxed); }
+    // the tsc when the clock read about ns; the error of about the offset doesn't matter to sysOffset()
+    int64_t ns2tsc(int64_t ns) const
+    {
+        TscParam param = clock_.getParam();
+        return param.base_tsc + static_cast<int64_t>((ns - param.base_ns) / param.ns_per_tsc);
+    }
+
+    const Clock & clock_;
+    std::atomic<int64_t> realtime_minus_monotonic_ {0};
+    // written by refresh() while other threads translate
+};
+
+// Sample both clocks a few times and keep the pair read closest together
+template <typename Clock>
+void ClockMap<Clock>::refresh()
+{
+    auto read = [](clockid_t id) {
+        timespec ts;
+        clock_gettime(id, &ts);
+        return ts.tv_sec * Clock::NsPerSec + ts.tv_nsec;
+    };
+    int64_t best = std::numeric_limits<int64_t>::max(), diff = 0;
+    for(int32_t i = 0; i < 3; i++)
+    {
+        int64_t rt0 = read(CLOCK_REALTIME);
+        int64_t mono = read(CLOCK_MONOTONIC);
+        int64_t rt1 = read(CLOCK_REALTIME);
+        if(rt1 - rt0 < best)
+        {
+            best = rt1 - rt0;
+            diff = rt0 + (rt1 - rt0) / 2 - mono;
+        }
+    }
+    realtime_minus_monotonic_.store(diff, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,95 @@
+#!/bin/bash
+# Usage: CXX=g++ CXXFLAGS="-O2" ./codegen_check.sh
+# Compiles codegen_probe.cc to assembly and checks the hot path of TSCNS in each probe_ function:
+# - the shape: a single tsc read (none in tsc2ns()), no call (but the out of line selfCalibrate()), the sequence loaded
+#   exactly twice and every parameter at most once, one multiply per conversion
+# - the instruction count against the budget of the compiler and arch below, when there is one
+# Exits with 1 on any failure, e.g. after a change that leaves a call (or tail call) in rdns() or reloads a parameter.
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+cd "$(dirname "$0")"
+
+ARCH=$($CXX -dumpmachine | cut -d- -f1)
+if $CXX --version | grep -q clang; then COMPILER=clang; else COMPILER=gcc; fi
+ASM=$(mktemp)
+trap 'rm -f "$ASM"' EXIT
+$CXX -std=c++17 $CXXFLAGS -S codegen_probe.cc -o "$ASM" || exit 1
+
+# instruction budgets per compiler and arch: function:max_instructions, from the current code with the default
+# TSCNS_SEQLOCK_ATOMIC; lower them when a change makes the code shorter
+declare -A BUDGETS
+BUDGETS[gcc-x86_64]="probe_rdtsc:4 probe_tsc2ns:15 probe_rdns:18 probe_rdns_bounded:29 probe_self_rdns:27"
+
+# the instructions of function $1, without labels and directives
+body() {
+  awk -v fn="$1" '$0 ~ "^" fn ":" {f = 1; next} f && /\.cfi_endproc|^\t\.size/ {exit} f' "$ASM" \
+    | grep -v '^[.A-Za-z_0-9]*:' | grep -v '^\s*\.' | grep -v '^\s*$' | grep -v '^#'
+}
+
+count() {
+  echo "$2" | grep -cE "$1"
+}
+
+FAILED=0
+fail() {
+  echo "FAIL $1: $2"
+  FAILED=1
+}
+
+# $1: function, $2: clock symbol (empty if it reads none), $3: expected tsc reads, $4: expected multiplies,
+# $5: expected calls
+check() {
+  local fn=$1 clock=$2 tscs=$3 muls=$4 calls=$5
+  local code
+  code=$(body "$fn")
+  if [ -z "$code" ]; then
+    fail "$fn" "not found in the assembly"
+    return
+  fi
+  local n
+  n=$(echo "$code" | wc -l)
+  case $ARCH in
+    x86_64|i?86)
+      [ "$(count '^\s*rdtsc' "$code")" -eq "$tscs" ] || fail "$fn" "expected $tscs rdtsc"
+      [ "$(count '^\s*(call|jmp\s+[^.])' "$code")" -eq "$calls" ] || fail "$fn" "expected $calls call(s)"
+      [ "$(count '^\s*v?mulsd' "$code")" -eq "$muls" ] || fail "$fn" "expected $muls mulsd"
+      if [ -n "$clock" ]; then
+        # gcc writes 8+clock(%rip), clang clock+8(%rip); the sequence is at offset 0. lea is the call's this pointer
+        local operands
+        operands=$(echo "$code" | grep -v '^\s*lea' | grep -oE "([0-9]+\+)?$clock(\+[0-9]+)?\(%rip\)" | sed -E "s/^([0-9]+)\+$clock/$clock+\1/")
+        [ "$(echo "$operands" | grep -cx "$clock(%rip)")" -eq 2 ] || fail "$fn" "expected the sequence loaded twice"
+        local reloaded
+        reloaded=$(echo "$operands" | grep -v -x "$clock(%rip)" | sort | uniq -d | tr '\n' ' ')
+        [ -z "$reloaded" ] || fail "$fn" "parameter loaded more than once: $reloaded"
+      fi
+      ;;
+    aarch64)
+      [ "$(count 'mrs\s.*cntvct_el0' "$code")" -eq "$tscs" ] || fail "$fn" "expected $tscs mrs cntvct_el0"
+      [ "$(count '^\s*(bl|b)\s+[^.]' "$code")" -eq "$calls" ] || fail "$fn" "expected $calls call(s)"
+      [ "$(count '^\s*fmul\s' "$code")" -eq "$muls" ] || fail "$fn" "expected $muls fmul"
+      if [ -n "$clock" ]; then
+        [ "$(count '^\s*(ldar|ldapr)\s' "$code")" -eq 1 ] || fail "$fn" "expected a single acquire load of the sequence"
+        [ "$(count '^\s*dmb\s+ishld' "$code")" -eq 1 ] || fail "$fn" "expected a single dmb ishld"
+      fi
+      ;;
+  esac
+  local budget=""
+  for entry in ${BUDGETS[$COMPILER-$ARCH]}; do
+    [ "${entry%%:*}" = "$fn" ] && budget=${entry##*:}
+  done
+  if [ -n "$budget" ] && [ "$n" -gt "$budget" ]; then
+    fail "$fn" "$n instructions, budget $budget"
+  fi
+  echo "$fn: $n instructions${budget:+, budget $budget}"
+}
+
+echo "$($CXX --version | head -1), $ARCH, $CXXFLAGS"
+check probe_rdtsc "" 1 0 0
+check probe_tsc2ns probe_clock 0 1 0
+check probe_rdns probe_clock 1 1 0
+check probe_rdns_bounded probe_clock 1 2 0
+check probe_self_rdns probe_self_clock 1 1 1
+[ -n "${BUDGETS[$COMPILER-$ARCH]}" ] || echo "no instruction budget for $COMPILER on $ARCH, the counts above are informative"
+[ $FAILED -eq 0 ] && echo "codegen ok"
+exit $FAILED
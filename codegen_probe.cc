@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "tscns.hpp"
+
+// Not a program: codegen_check.sh compiles it with -S and checks the instructions of each function below, which hold
+// nothing but the inlined hot path of TSCNS. Keep the probe_ names, the script looks them up.
+
+tscns::TSCNS<> probe_clock;
+tscns::TSCNS<64, true> probe_self_clock;
+
+extern "C" {
+
+int64_t probe_rdtsc()
+{
+    return tscns::TSCNS<>::rdtsc();
+}
+
+int64_t probe_tsc2ns(int64_t tsc)
+{
+    return probe_clock.tsc2ns(tsc);
+}
+
+int64_t probe_rdns()
+{
+    return probe_clock.rdns();
+}
+
+tscns::TimeInterval probe_rdns_bounded()
+{
+    return probe_clock.rdnsBounded();
+}
+
+int64_t probe_self_rdns()
+{
+    return probe_self_clock.rdns();
+}
+
+}
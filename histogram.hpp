@@ -0,0 +1,188 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <array>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace tscns {
+
+/**
+ * @brief Log-linear histogram of non-negative int64 values (latencies in ns, gaps in tsc...).
+ * Values are grouped by their highest bit, and each group is split linearly into 2^kSubBucketBits buckets, so the
+ * relative error of a bucket is below 2^-kSubBucketBits (6.25% by default) and values below 2^kSubBucketBits are exact.
+ * Recording is a few instructions and never allocates; the counts are plain integers, so an instance is meant to be
+ * owned by one thread, and merge() combines the ones from different threads.
+ */
+template <int32_t kSubBucketBits = 4>
+class Histogram
+{
+public:
+    static constexpr int32_t SubBuckets = 1 << kSubBucketBits;
+    static constexpr int32_t Buckets = (64 - kSubBucketBits + 1) * SubBuckets;
+
+    void record(int64_t value, int64_t count = 1);
+    void merge(const Histogram & other);
+    void reset();
+    int64_t count() const { return count_; }
+    int64_t min() const { return count_ ? min_ : 0; }
+    int64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+    int64_t percentile(double p) const;
+
+    // f(lower, upper, count) for every non empty bucket, in increasing order of value
+    template <typename F>
+    void forEachBucket(F && f) const;
+
+    static int32_t bucketOf(int64_t value);
+    static int64_t bucketLower(int32_t bucket);
+    static int64_t bucketUpper(int32_t bucket);
+
+private:
+    static int32_t highestBit(uint64_t value);
+
+    std::array<int64_t, Buckets> counts_ {};
+    int64_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t min_ = INT64_MAX;
+    int64_t max_ = 0;
+};
+
+template <int32_t kSubBucketBits>
+int32_t Histogram<kSubBucketBits>::highestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int32_t>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+template <int32_t kSubBucketBits>
+int32_t Histogram<kSubBucketBits>::bucketOf(int64_t value)
+{
+    uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+    if(v < static_cast<uint64_t>(SubBuckets))
+    {
+        return static_cast<int32_t>(v);
+    }
+    int32_t shift = highestBit(v) - kSubBucketBits;
+    // the highest bit selects the group, the next kSubBucketBits bits the bucket within it
+    return ((shift + 1) << kSubBucketBits) + static_cast<int32_t>((v >> shift) & (SubBuckets - 1));
+}
+
+template <int32_t kSubBucketBits>
+int64_t Histogram<kSubBucketBits>::bucketLower(int32_t bucket)
+{
+    if(bucket < SubBuckets)
+    {
+        return bucket;
+    }
+    int32_t shift = (bucket >> kSubBucketBits) - 1;
+    return static_cast<int64_t>((static_cast<uint64_t>(SubBuckets) + (bucket & (SubBuckets - 1))) << shift);
+}
+
+template <int32_t kSubBucketBits>
+int64_t Histogram<kSubBucketBits>::bucketUpper(int32_t bucket)
+{
+    if(bucket < SubBuckets)
+    {
+        return bucket;
+    }
+    int32_t shift = (bucket >> kSubBucketBits) - 1;
+    return bucketLower(bucket) + static_cast<int64_t>((uint64_t(1) << shift) - 1);
+}
+
+template <int32_t kSubBucketBits>
+void Histogram<kSubBucketBits>::record(int64_t value, int64_t count)
+{
+    counts_[bucketOf(value)] += count;
+    count_ += count;
+    sum_ += value * count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+template <int32_t kSubBucketBits>
+void Histogram<kSubBucketBits>::merge(const Histogram & other)
+{
+    for(int32_t i = 0; i < Buckets; i++)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+template <int32_t kSubBucketBits>
+void Histogram<kSubBucketBits>::reset()
+{
+    *this = Histogram();
+}
+
+// Upper bound of the bucket holding the p-th percentile (p in [0, 100]), clamped to the max recorded value
+template <int32_t kSubBucketBits>
+int64_t Histogram<kSubBucketBits>::percentile(double p) const
+{
+    if(count_ == 0)
+    {
+        return 0;
+    }
+    int64_t rank = static_cast<int64_t>(p / 100.0 * count_ + 0.5);
+    rank = std::min(std::max(rank, int64_t(1)), count_);
+    int64_t seen = 0;
+    for(int32_t i = 0; i < Buckets; i++)
+    {
+        seen += counts_[i];
+        if(seen >= rank)
+        {
+            return std::min(bucketUpper(i), max_);
+        }
+    }
+    return max_;
+}
+
+template <int32_t kSubBucketBits>
+template <typename F>
+void Histogram<kSubBucketBits>::forEachBucket(F && f) const
+{
+    for(int32_t i = 0; i < Buckets; i++)
+    {
+        if(counts_[i])
+        {
+            f(bucketLower(i), bucketUpper(i), counts_[i]);
+        }
+    }
+}
+
+}
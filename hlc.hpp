@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include "tscns.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Hybrid logical clock built on a TSCNS clock, for ordering events across threads and processes.
+ * A timestamp is a single 64 bit word: the physical ns from rdns() with the lowest kLogicalBits bits replaced by a
+ * logical counter. So timestamps compare as plain integers and stay close to rdns(): the physical part has
+ * 2^kLogicalBits ns granularity (256 ns by default).
+ *
+ * Every timestamp returned is larger than any timestamp returned or received before it, even if the physical clock
+ * ties or goes backwards after a calibration. If the logical counter overflows it carries into the physical part, i.e.
+ * the clock runs a little ahead of physical time until the physical time catches up, which is what HLC allows.
+ *
+ * The state is one atomic word updated by a CAS loop, so it's lock-free and can be shared by all threads.
+ */
+template <typename Clock = TSCNS<>, int32_t kLogicalBits = 8, int32_t kCachelineSize = 64>
+class HLC
+{
+public:
+    explicit HLC(const Clock & clock) : clock_(clock) {}
+    uint64_t now();
+    uint64_t send();
+    uint64_t recv(uint64_t remote_ts);
+    uint64_t last() const;
+    static int64_t physical(uint64_t ts);
+    static uint32_t logical(uint64_t ts);
+
+    static constexpr uint64_t LogicalMask = (uint64_t(1) << kLogicalBits) - 1;
+
+private:
+    uint64_t update(uint64_t floor_ts);
+
+    const Clock & clock_;
+    alignas(kCachelineSize) std::atomic<uint64_t> last_ts_ {0};
+    std::array<uint8_t, kCachelineSize - sizeof(last_ts_) % kCachelineSize> padding_;
+    // the state is written by every thread, keep it in a cacheline of its own
+};
+
+// Local event
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+uint64_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::now()
+{
+    return update(0);
+}
+
+// Timestamp to be sent with a message, same as a local event
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+uint64_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::send()
+{
+    return update(0);
+}
+
+// Merge the timestamp of a received message, the returned timestamp is larger than both local and remote ones
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+uint64_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::recv(uint64_t remote_ts)
+{
+    return update(remote_ts + 1);
+}
+
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+uint64_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::last() const
+{
+    return last_ts_.load(std::memory_order_relaxed);
+}
+
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+int64_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::physical(uint64_t ts)
+{
+    return static_cast<int64_t>(ts & ~LogicalMask);
+}
+
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+uint32_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::logical(uint64_t ts)
+{
+    return static_cast<uint32_t>(ts & LogicalMask);
+}
+
+template <typename Clock, int32_t kLogicalBits, int32_t kCachelineSize>
+uint64_t TSCNS_FORCE_INLINE HLC<Clock, kLogicalBits, kCachelineSize>::update(uint64_t floor_ts)
+{
+    uint64_t pt = static_cast<uint64_t>(clock_.rdns()) & ~LogicalMask;
+    // physical time with a zero logical counter
+    uint64_t last_ts = last_ts_.load(std::memory_order_relaxed);
+    uint64_t ts;
+    do
+    {
+        ts = std::max(std::max(pt, floor_ts), last_ts + 1);
+        // if the physical time didn't move past the last timestamp, increase the logical counter instead
+    } while(!last_ts_.compare_exchange_weak(last_ts, ts, std::memory_order_relaxed));
+    // The timestamp itself carries the causality, so relaxed is enough: all updates on last_ts_ are totally ordered
+    return ts;
+}
+
+}
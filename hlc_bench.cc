@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include "hlc.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Measures the cost of HLC updates with all threads hammering one clock, and checks the timestamps each thread gets
+// are strictly increasing.
+
+static tscns::TSCNS<> tn;
+static tscns::HLC<> hlc(tn);
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_hlc_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int max_threads = argc > 1 ? stoi(argv[1]) : (int)std::thread::hardware_concurrency();
+  const int N = argc > 2 ? stoi(argv[2]) : 1000000;
+  tn.init();
+
+  {
+    int64_t tmp = 0;
+    int64_t t0 = tn.rdns();
+    for (int i = 0; i < N; i++) {
+      tmp += tn.rdns();
+    }
+    int64_t t1 = tn.rdns();
+    cout << std::setprecision(3) << fixed << "rdns_latency: " << (double)(t1 - t0) / N << ", tmp: " << tmp << endl;
+  }
+
+  vector<int> thread_counts;
+  for (int n = 1; n < max_threads; n *= 2) thread_counts.push_back(n);
+  thread_counts.push_back(max_threads);
+  for (int nthreads : thread_counts) {
+    vector<thread> thrs;
+    vector<int64_t> latency(nthreads);
+    std::atomic<int> bad{0};
+    std::atomic<int> ready{0};
+    for (int t = 0; t < nthreads; t++) {
+      thrs.emplace_back([&, t]() {
+        ready++;
+        while (ready.load() < nthreads)
+          ;
+        uint64_t last = 0;
+        int64_t t0 = tn.rdns();
+        for (int i = 0; i < N; i++) {
+          // mix in a receive every now and then, as if a message from another process came in
+          uint64_t ts = (i & 63) ? hlc.now() : hlc.recv(last + 1000);
+          if (ts <= last) bad++;
+          last = ts;
+        }
+        latency[t] = tn.rdns() - t0;
+      });
+    }
+    for (auto& thr : thrs) thr.join();
+    int64_t total = 0;
+    for (auto l : latency) total += l;
+    cout << "threads: " << nthreads << ", hlc_latency: " << (double)total / nthreads / N
+         << ", last physical: " << tscns::HLC<>::physical(hlc.last())
+         << ", last logical: " << tscns::HLC<>::logical(hlc.last()) << ", non-increasing: " << bad.load() << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include "idgen.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Every thread mints ids from its own shard as fast as it can, then we check they're increasing per shard and see how
+// far the time part ran ahead of the clock because of sequence exhaustion.
+
+static tscns::TSCNS<> tn;
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_idgen_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int nthreads = argc > 1 ? stoi(argv[1]) : 32;
+  const int N = argc > 2 ? stoi(argv[2]) : 10000000;
+  tn.init();
+
+  using IdGen = tscns::IdGen<>;
+  vector<thread> thrs;
+  vector<int64_t> latency(nthreads);
+  vector<int64_t> ahead(nthreads);
+  std::atomic<int> bad{0};
+  std::atomic<int> ready{0};
+  for (int t = 0; t < nthreads; t++) {
+    thrs.emplace_back([&, t]() {
+      IdGen gen(tn, t);
+      ready++;
+      while (ready.load() < nthreads)
+        ;
+      uint64_t last = 0;
+      int64_t t0 = tn.rdns();
+      for (int i = 0; i < N; i++) {
+        uint64_t id = gen.next();
+        if (id <= last || IdGen::shard(id) != (uint32_t)t) bad++;
+        last = id;
+      }
+      int64_t t1 = tn.rdns();
+      latency[t] = t1 - t0;
+      ahead[t] = gen.timeNs(last) - t1;
+    });
+  }
+  for (auto& thr : thrs) thr.join();
+
+  int64_t total = 0, max_ahead = 0;
+  for (int t = 0; t < nthreads; t++) {
+    total += latency[t];
+    max_ahead = max(max_ahead, ahead[t]);
+  }
+  // a clock before the epoch must read as the epoch, not wrap around to the far future
+  int64_t epoch_ns = tn.rdns() + tn.NsPerSec;
+  IdGen early(tn, 0, epoch_ns);
+  if (early.timeNs(early.next()) != epoch_ns) bad++;
+
+  cout << std::setprecision(3) << fixed << "threads: " << nthreads << ", ids per thread: " << N
+       << ", id_latency: " << (double)total / nthreads / N << ", max time ahead of clock (ns): " << max_ahead
+       << ", bad: " << bad.load() << endl;
+
+  return bad.load() ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <vector>
+#include "tscns.hpp"
+#include "histogram.hpp"
+
+namespace tscns {
+
+struct JitterGap
+{
+    int64_t tsc;
+    // tsc read right before the gap
+    int64_t gap_tsc;
+};
+
+/**
+ * @brief sysjitter/jHiccup style probe of host noise: spins on rdtsc() and records every gap between two consecutive
+ * reads above a threshold, which is time the thread didn't get to run (SMI, interrupt, page fault, hypervisor steal...).
+ * The gaps are stamped with raw tsc, so they can be put on the same timeline as the rdns() timestamps of the
+ * application through tsc2ns().
+ *
+ * run() is meant to be called on a thread pinned to the core to probe. Gap records are preallocated, gaps beyond
+ * max_gaps are only counted.
+ */
+template <typename Clock = TSCNS<>>
+class JitterMeter
+{
+public:
+    explicit JitterMeter(const Clock & clock, size_t max_gaps = 1 << 20);
+    void run(int64_t threshold_ns, int64_t duration_ns, const std::atomic<bool> * stop = nullptr);
+    const std::vector<JitterGap> & gaps() const { return gaps_; }
+    template <typename H = Histogram<>>
+    H gapHistogram() const;
+    int64_t loops() const { return loops_; }
+    int64_t droppedGaps() const { return dropped_; }
+    int64_t stolenNs() const;
+    int64_t runNs() const;
+
+private:
+    const Clock & clock_;
+    size_t max_gaps_;
+    std::vector<JitterGap> gaps_;
+    int64_t loops_ = 0;
+    int64_t dropped_ = 0;
+    int64_t start_tsc_ = 0;
+    int64_t end_tsc_ = 0;
+};
+
+template <typename Clock>
+JitterMeter<Clock>::JitterMeter(const Clock & clock, size_t max_gaps)
+    : clock_(clock)
+    , max_gaps_(max_gaps)
+{
+    gaps_.reserve(max_gaps);
+}
+
+// Spin for duration_ns, or until *stop is set, recording gaps longer than threshold_ns. Records of previous runs are
+// cleared.
+template <typename Clock>
+void JitterMeter<Clock>::run(int64_t threshold_ns, int64_t duration_ns, const std::atomic<bool> * stop)
+{
+    gaps_.clear();
+    loops_ = 0;
+    dropped_ = 0;
+    double tsc_ghz = clock_.getTscGhz();
+    int64_t threshold_tsc = static_cast<int64_t>(threshold_ns * tsc_ghz);
+    int64_t prev = clock_.rdtsc();
+    int64_t expire_tsc = prev + static_cast<int64_t>(duration_ns * tsc_ghz);
+    start_tsc_ = prev;
+    int64_t loops = 0;
+    while(true)
+    {
+        int64_t now = clock_.rdtsc();
+        if(now - prev > threshold_tsc)
+        {
+            if(gaps_.size() < max_gaps_)
+            {
+                gaps_.push_back({prev, now - prev});
+            }
+            else
+            {
+                dropped_++;
+            }
+        }
+        prev = now;
+        if(now >= expire_tsc || ((++loops & 1023) == 0 && stop && stop->load(std::memory_order_relaxed)))
+        {
+            // the stop flag is checked once in a while only, to keep the loop tight
+            break;
+        }
+    }
+    loops_ = loops;
+    end_tsc_ = prev;
+}
+
+// Histogram of the recorded gaps in ns
+template <typename Clock>
+template <typename H>
+H JitterMeter<Clock>::gapHistogram() const
+{
+    H hist;
+    for(const JitterGap & gap : gaps_)
+    {
+        hist.record(clock_.tsc2ns(gap.tsc + gap.gap_tsc) - clock_.tsc2ns(gap.tsc));
+    }
+    return hist;
+}
+
+// Total time of the recorded gaps in ns
+template <typename Clock>
+int64_t JitterMeter<Clock>::stolenNs() const
+{
+    int64_t gap_tsc = 0;
+    for(const JitterGap & gap : gaps_)
+    {
+        gap_tsc += gap.gap_tsc;
+    }
+    return static_cast<int64_t>(gap_tsc / clock_.getTscGhz());
+}
+
+template <typename Clock>
+int64_t JitterMeter<Clock>::runNs() const
+{
+    return clock_.tsc2ns(end_tsc_) - clock_.tsc2ns(start_tsc_);
+}
+
+}
@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include "jitter.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: jitter_meter [threshold_ns] [duration_s] [cpu...]
+// Spins on every given cpu (or just where the OS puts us if none is given) and prints the gaps found there: a
+// histogram per cpu, then a timeline of all the gaps stamped with the same clock rdns() uses.
+
+static tscns::TSCNS<> tn;
+
+static string ptime(int64_t ts) {
+  struct tm* dt;
+  string ret(18, '0');
+  time_t sec = ts / 1000000000;
+  int ns = ts % 1000000000;
+  dt = localtime(&sec);
+  strftime(const_cast<char *>(ret.data()), 18, "%H:%M:%S.", dt);
+  for (int i = 17; i >= 9; i--) {
+    ret[i] = '0' + (ns % 10);
+    ns /= 10;
+  }
+  return ret;
+}
+
+static bool pinThread(int cpu) {
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+  return cpu < 0;
+#endif
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_jitter_meter_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int64_t threshold_ns = argc > 1 ? stoll(argv[1]) : 1000;
+  int64_t duration_ns = (argc > 2 ? stoll(argv[2]) : 10) * tn.NsPerSec;
+  vector<int> cpus;
+  for (int i = 3; i < argc; i++) cpus.push_back(stoi(argv[i]));
+  if (cpus.empty()) cpus.push_back(-1);
+
+  tn.init();
+  cout << std::setprecision(3) << fixed << "tsc_ghz: " << tn.getTscGhz() << ", threshold_ns: " << threshold_ns
+       << ", duration_ns: " << duration_ns << endl;
+
+  vector<unique_ptr<tscns::JitterMeter<>>> meters;
+  vector<thread> thrs;
+  for (int cpu : cpus) {
+    meters.emplace_back(new tscns::JitterMeter<>(tn));
+    auto* meter = meters.back().get();
+    thrs.emplace_back([=]() {
+      if (cpu >= 0 && !pinThread(cpu)) cerr << "failed to pin to cpu " << cpu << endl;
+      meter->run(threshold_ns, duration_ns);
+    });
+  }
+  for (auto& thr : thrs) thr.join();
+
+  struct Event {
+    int64_t ns;
+    int64_t gap_ns;
+    int cpu;
+  };
+  vector<Event> timeline;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    auto& meter = *meters[i];
+    auto hist = meter.gapHistogram();
+    cout << "cpu: " << cpus[i] << ", loops: " << meter.loops() << ", gaps: " << meter.gaps().size()
+         << ", dropped: " << meter.droppedGaps() << ", stolen_ns: " << meter.stolenNs()
+         << ", stolen: " << 100.0 * meter.stolenNs() / max(meter.runNs(), int64_t(1)) << "%"
+         << ", p50: " << hist.percentile(50) << ", p99: " << hist.percentile(99) << ", max: " << hist.max() << endl;
+    hist.forEachBucket([](int64_t lower, int64_t upper, int64_t count) {
+      cout << "  [" << lower << ", " << upper << "] ns: " << count << endl;
+    });
+    for (auto& gap : meter.gaps()) {
+      int64_t ns = tn.tsc2ns(gap.tsc);
+      timeline.push_back({ns, tn.tsc2ns(gap.tsc + gap.gap_tsc) - ns, cpus[i]});
+    }
+  }
+
+  sort(timeline.begin(), timeline.end(), [](const Event& a, const Event& b) { return a.ns < b.ns; });
+  cout << "timeline:" << endl;
+  for (auto& e : timeline) {
+    cout << ptime(e.ns) << " cpu: " << e.cpu << ", gap_ns: " << e.gap_ns << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include "clock_map.hpp"
+#include "histogram.hpp"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Loopback UDP: a sender thread paces packets to a receiving socket with SO_TIMESTAMPNS on, the receiver takes rdns()
+// as soon as recvmsg() returns and measures kernel-to-user latency against the kernel's CLOCK_REALTIME stamp, either
+// translated by ClockMap or taken as is. The clock calibrates every 100 ms meanwhile, so the raw difference carries
+// the calibration offset (sometimes below zero), the translated one doesn't. clock_gettime() right after recvmsg()
+// gives the reference.
+
+static tscns::TSCNS<> tn;
+
+// reference is the latency measured with clock_gettime(), to see how far this one is off
+struct Latency {
+  tscns::Histogram<> hist;
+  int64_t negative = 0, n = 0;
+  double err_sum = 0;
+  int64_t err_max = 0;
+  void add(int64_t ns, int64_t reference) {
+    negative += ns < 0;
+    hist.record(ns);
+    n++;
+    err_sum += ns - reference;
+    err_max = max(err_max, std::abs(ns - reference));
+  }
+  void print(const char* name) {
+    cout << std::setw(12) << name << ": p50: " << hist.percentile(50) << ", p99: " << hist.percentile(99)
+         << ", max: " << hist.max() << ", below zero: " << negative << ", vs realtime mean: " << std::setprecision(1)
+         << fixed << err_sum / max(n, int64_t(1)) << ", max |diff|: " << err_max << endl;
+  }
+};
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_kernel_ts_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+#ifdef __linux__
+  const int N = argc > 1 ? stoi(argv[1]) : 200'000;
+  const int64_t gap_ns = argc > 2 ? stoll(argv[2]) : 10'000;
+  tn.init(20'000'000, 100'000'000);
+  tscns::ClockMap<> map(tn);
+
+  int rx = socket(AF_INET, SOCK_DGRAM, 0), tx = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  int on = 1;
+  if (bind(rx, (sockaddr*)&addr, sizeof(addr)) || getsockname(rx, (sockaddr*)&addr, &addr_len) ||
+      setsockopt(rx, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on))) {
+    cerr << "socket setup failed: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  atomic<bool> running{true};
+  thread calibrator([&]() {
+    while (running.load()) {
+      tn.calibrate();
+      map.refresh();
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+  });
+  thread sender([&]() {
+    char payload[64] = {};
+    for (int i = 0; i <= N; i++) {
+      int64_t next = tn.rdns() + gap_ns;
+      sendto(tx, payload, sizeof(payload), 0, (sockaddr*)&addr, sizeof(addr));
+      while (tn.rdns() < next) this_thread::yield();
+    }
+  });
+
+  Latency mapped, raw, realtime;
+  int64_t no_stamp = 0;
+  char buf[2048], control[256];
+  for (int i = 0; i <= N; i++) {
+    iovec iov{buf, sizeof(buf)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(rx, &msg, 0) < 0) break;
+    int64_t user_ns = tn.rdns();
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    const timespec* kernel = nullptr;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) kernel = (const timespec*)CMSG_DATA(c);
+    }
+    if (!kernel) {
+      no_stamp++;
+      continue;
+    }
+    if (i == 0) continue;
+    // warm-up packet
+    int64_t kernel_ns = kernel->tv_sec * tscns::TSCNS<>::NsPerSec + kernel->tv_nsec;
+    int64_t reference = now.tv_sec * tscns::TSCNS<>::NsPerSec + now.tv_nsec - kernel_ns;
+    mapped.add(user_ns - map.fromTimespec(*kernel), reference);
+    raw.add(user_ns - kernel_ns, reference);
+    realtime.add(reference, reference);
+  }
+  sender.join();
+  running = false;
+  calibrator.join();
+  close(rx);
+  close(tx);
+
+  cout << "packets: " << N << ", without kernel timestamp: " << no_stamp << ", kernel-to-user latency ns:" << endl;
+  mapped.print("mapped rdns");
+  raw.print("raw rdns");
+  realtime.print("realtime");
+#else
+  cerr << "loopback SO_TIMESTAMPNS benchmark needs Linux" << endl;
+#endif
+  return 0;
+}
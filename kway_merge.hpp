@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <vector>
+#include <thread>
+#include "loser_tree.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Sorted run of records, e.g. a per-thread trace buffer whose records are in increasing tsc order.
+ */
+template <typename T>
+struct MergeRun
+{
+    const T * data;
+    size_t size;
+};
+
+namespace detail {
+
+// First record in [begin, end) with key > bound, by galloping: cheap when the block is short, log when it's long
+template <typename T, typename KeyF>
+const T * gallopAbove(const T * begin, const T * end, int64_t bound, KeyF & key)
+{
+    size_t step = 1;
+    const T * lo = begin;
+    while(lo + step < end && key(lo[step]) <= bound)
+    {
+        lo += step;
+        step <<= 1;
+    }
+    const T * hi = lo + step < end ? lo + step + 1 : end;
+    return std::upper_bound(lo, hi, bound, [&key](int64_t b, const T & rec) { return b < key(rec); });
+}
+
+template <typename In, typename Out, typename KeyF, typename ConvF>
+void mergeRanges(std::vector<std::pair<const In *, const In *>> ranges, Out * out, KeyF key, ConvF conv)
+{
+    LoserTree tree(static_cast<int32_t>(ranges.size()));
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+        tree.setKey(i, ranges[i].first < ranges[i].second ? key(*ranges[i].first) : LoserTree::Inf);
+    }
+    tree.build();
+    while(tree.winnerKey() != LoserTree::Inf)
+    {
+        int32_t w = tree.winner();
+        auto & range = ranges[w];
+        const In * stop = gallopAbove(range.first + 1, range.second, tree.runnerUpKey(), key);
+        // the whole block up to the runner-up's key goes out in one tight loop, without touching the tree
+        for(const In * rec = range.first; rec < stop; rec++)
+        {
+            *out++ = conv(*rec);
+        }
+        range.first = stop;
+        tree.update(w, stop < range.second ? key(*stop) : LoserTree::Inf);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Merges sorted runs into out by the int64 key (normally the raw tsc) of their records, converting each record
+ * with conv on the way, e.g. to replace the tsc with ns through tsc2ns() or a TscEpochs::Cursor.
+ * out must have room for all records of all runs. key(const In &) -> int64_t, conv(const In &) -> Out.
+ */
+template <typename In, typename Out, typename KeyF, typename ConvF>
+void kwayMerge(const std::vector<MergeRun<In>> & runs, Out * out, KeyF key, ConvF conv)
+{
+    std::vector<std::pair<const In *, const In *>> ranges;
+    for(const MergeRun<In> & run : runs)
+    {
+        ranges.emplace_back(run.data, run.data + run.size);
+    }
+    detail::mergeRanges(std::move(ranges), out, key, conv);
+}
+
+/**
+ * @brief Same as kwayMerge(), split into independent merges run by nthreads threads.
+ * The key space is cut at values splitting the records evenly, every run is cut there by binary search, and each
+ * thread merges one slice of all runs into its own part of out. conv is copied into each thread, so a stateful
+ * converter (like a TscEpochs::Cursor) works as long as copies are independent.
+ */
+template <typename In, typename Out, typename KeyF, typename ConvF>
+void parallelKwayMerge(const std::vector<MergeRun<In>> & runs, Out * out, KeyF key, ConvF conv, int32_t nthreads)
+{
+    auto lowerBound = [&key](const MergeRun<In> & run, int64_t v) {
+        return static_cast<size_t>(std::lower_bound(run.data, run.data + run.size, v,
+                                                    [&key](const In & rec, int64_t b) { return key(rec) < b; }) -
+                                   run.data);
+    };
+    size_t total = 0;
+    int64_t min_key = LoserTree::Inf, max_key = std::numeric_limits<int64_t>::min();
+    for(const MergeRun<In> & run : runs)
+    {
+        total += run.size;
+        if(run.size)
+        {
+            min_key = std::min(min_key, key(run.data[0]));
+            max_key = std::max(max_key, key(run.data[run.size - 1]));
+        }
+    }
+    if(nthreads <= 1 || total == 0)
+    {
+        kwayMerge(runs, out, key, conv);
+        return;
+    }
+
+    // cuts[t][r]: where slice t starts in run r
+    std::vector<std::vector<size_t>> cuts(nthreads + 1, std::vector<size_t>(runs.size()));
+    for(size_t r = 0; r < runs.size(); r++)
+    {
+        cuts[nthreads][r] = runs[r].size;
+    }
+    for(int32_t t = 1; t < nthreads; t++)
+    {
+        // smallest key value with at least total * t / nthreads records below it
+        size_t target = total * t / nthreads;
+        int64_t lo = min_key, hi = max_key;
+        while(lo < hi)
+        {
+            int64_t mid = lo + (hi - lo) / 2;
+            size_t below = 0;
+            for(const MergeRun<In> & run : runs)
+            {
+                below += lowerBound(run, mid);
+            }
+            if(below < target)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        for(size_t r = 0; r < runs.size(); r++)
+        {
+            cuts[t][r] = std::max(lowerBound(runs[r], lo), cuts[t - 1][r]);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    size_t offset = 0;
+    for(int32_t t = 0; t < nthreads; t++)
+    {
+        std::vector<std::pair<const In *, const In *>> ranges;
+        size_t count = 0;
+        for(size_t r = 0; r < runs.size(); r++)
+        {
+            ranges.emplace_back(runs[r].data + cuts[t][r], runs[r].data + cuts[t + 1][r]);
+            count += cuts[t + 1][r] - cuts[t][r];
+        }
+        threads.emplace_back(detail::mergeRanges<In, Out, KeyF, ConvF>, std::move(ranges), out + offset, key, conv);
+        offset += count;
+    }
+    for(std::thread & thread : threads)
+    {
+        thread.join();
+    }
+}
+
+}
@@ -0,0 +1,121 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include "kway_merge.hpp"
+#include "tsc_epochs.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: kway_merge_bench [runs] [records_per_run] [threads]
+// Builds per-thread style buffers of tsc stamped records, merges them into one ns stamped timeline with a few
+// calibration epochs along the way, single threaded and in parallel, and checks the results.
+
+static tscns::TSCNS<> tn;
+
+struct Record {
+  int64_t tsc;
+  int64_t payload;
+};
+
+struct Exported {
+  int64_t ns;
+  int64_t payload;
+};
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_kway_merge_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int nruns = argc > 1 ? stoi(argv[1]) : 64;
+  size_t per_run = argc > 2 ? stoull(argv[2]) : 1000000;
+  int nthreads = argc > 3 ? stoi(argv[3]) : (int)std::thread::hardware_concurrency();
+  tn.init();
+
+  // fake some history: a few epochs with slightly different frequencies
+  tscns::TscEpochs epochs;
+  tscns::TscParam param = tn.getParam();
+  int64_t span = (int64_t)per_run * 100;
+  for (int e = 0; e < 4; e++) {
+    epochs.add(param);
+    int64_t next_tsc = param.base_tsc + span / 4;
+    param = {next_tsc, param.tsc2ns(next_tsc), param.ns_per_tsc * (1 + (e % 2 ? 1e-6 : -1e-6))};
+  }
+
+  std::mt19937_64 rng(1);
+  vector<vector<Record>> buffers(nruns);
+  vector<tscns::MergeRun<Record>> runs;
+  for (int r = 0; r < nruns; r++) {
+    int64_t tsc = epochs[0].base_tsc + (int64_t)(rng() % 1000);
+    for (size_t i = 0; i < per_run; i++) {
+      // bursty: mostly small steps, sometimes a long quiet period, so there are blocks to gallop over
+      tsc += rng() % 16 == 0 ? (int64_t)(rng() % 20000) : (int64_t)(rng() % 50);
+      buffers[r].push_back({tsc, r});
+    }
+    runs.push_back({buffers[r].data(), buffers[r].size()});
+  }
+  size_t total = (size_t)nruns * per_run;
+  vector<Exported> single(total), parallel(total);
+
+  auto key = [](const Record& rec) { return rec.tsc; };
+  auto check = [&](const vector<Exported>& out) {
+    for (size_t i = 1; i < out.size(); i++) {
+      if (out[i].ns < out[i - 1].ns) return false;
+    }
+    return true;
+  };
+
+  {
+    tscns::TscEpochs::Cursor cursor(epochs);
+    int64_t t0 = tn.rdns();
+    tscns::kwayMerge(runs, single.data(), key,
+                     [&](const Record& rec) { return Exported{cursor.tsc2ns(rec.tsc), rec.payload}; });
+    int64_t t1 = tn.rdns();
+    cout << std::setprecision(3) << fixed << "single: records: " << total
+         << ", Mrecords/s: " << total * 1000.0 / (t1 - t0) << ", sorted: " << check(single) << endl;
+  }
+  {
+    int64_t t0 = tn.rdns();
+    tscns::parallelKwayMerge(
+      runs, parallel.data(), key,
+      [cursor = tscns::TscEpochs::Cursor(epochs)](const Record& rec) mutable {
+        return Exported{cursor.tsc2ns(rec.tsc), rec.payload};
+      },
+      nthreads);
+    int64_t t1 = tn.rdns();
+    bool same = true;
+    for (size_t i = 0; i < total; i++) same &= single[i].ns == parallel[i].ns;
+    cout << "parallel: threads: " << nthreads << ", Mrecords/s: " << total * 1000.0 / (t1 - t0)
+         << ", sorted: " << check(parallel) << ", same as single: " << same << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include "tscns.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: latency_guard [cpu] [name=max_ns...]
+// Latency regression guard for the hot path, to run pinned on an otherwise idle cpu: measures rdtsc(), rdns(),
+// rdnsBounded() and self-calibrating rdns() back to back, and a chain of tsc2ns() each fed by the previous result,
+// then fails (exit 1) if any of them is over its threshold. The calls are compared to rdtsc() rather than given in
+// absolute ns, since rdtsc() alone costs from 6 ns on bare metal to 20+ ns under some hypervisors.
+// The defaults below hold on x86 servers with some margin; tighten or relax them with name=max_ns.
+// codegen_check.sh is the other half of the regression suite, it checks the instructions of the same calls.
+
+static tscns::TSCNS<> tn;
+static tscns::TSCNS<64, true> self_tn;
+
+static constexpr int Rounds = 101;
+static constexpr int BatchCalls = 100'000;
+
+static volatile int64_t sink;
+
+static bool pinThread(int cpu) {
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+  return cpu < 0;
+#endif
+}
+
+// ns per call of f over one batch of BatchCalls calls
+template <typename F>
+static double batchNs(F f) {
+  int64_t sum = 0;
+  int64_t begin = tn.rdtsc();
+  for (int i = 0; i < BatchCalls; i++) sum += f();
+  int64_t end = tn.rdtsc();
+  sink = sum;
+  return (end - begin) / tn.getTscGhz() / BatchCalls;
+}
+
+static double median(vector<double> v) {
+  nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+  return v[v.size() / 2];
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_latency_guard_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int cpu = argc > 1 ? stoi(argv[1]) : -1;
+  map<string, double> max_ns = {
+    {"rdns_over_rdtsc", 6.0},
+    {"bounded_over_rdtsc", 10.0},
+    {"self_over_rdtsc", 6.0},
+    {"tsc2ns_chain", 12.0},
+  };
+  for (int i = 2; i < argc; i++) {
+    string arg = argv[i];
+    size_t eq = arg.find('=');
+    if (eq == string::npos || !max_ns.count(arg.substr(0, eq))) {
+      cerr << "unknown threshold: " << arg << endl;
+      return 2;
+    }
+    max_ns[arg.substr(0, eq)] = stod(arg.substr(eq + 1));
+  }
+  if (cpu >= 0 && !pinThread(cpu)) {
+    cerr << "failed to pin to cpu " << cpu << endl;
+    return 2;
+  }
+  tn.init();
+  self_tn.init(20'000'000, 1000 * tn.NsPerSec);
+  // the self-calibrating clock is measured on its not-due path: it must cost a compare over rdns()
+
+  // the calls take turns batch by batch and are compared within each round, so frequency changes and noise hit
+  // them alike; the median round is kept
+  vector<double> rdtsc_ns, rdns_over, bounded_over, self_over, chain_ns;
+  int64_t chain = tn.rdtsc();
+  for (int round = 0; round < Rounds; round++) {
+    double base = batchNs([]() { return tn.rdtsc(); });
+    rdtsc_ns.push_back(base);
+    rdns_over.push_back(batchNs([]() { return tn.rdns(); }) - base);
+    bounded_over.push_back(batchNs([]() { return tn.rdnsBounded().latest; }) - base);
+    self_over.push_back(batchNs([]() { return self_tn.rdns(); }) - base);
+    chain_ns.push_back(batchNs([&chain]() {
+      chain = tn.tsc2ns(chain) & 0xffffffffffff;
+      // masked so it stays in the range of tsc values
+      return chain;
+    }));
+  }
+
+  map<string, double> measured = {
+    {"rdns_over_rdtsc", median(rdns_over)},
+    {"bounded_over_rdtsc", median(bounded_over)},
+    {"self_over_rdtsc", median(self_over)},
+    {"tsc2ns_chain", median(chain_ns)},
+  };
+  cout << setprecision(2) << fixed << "cpu: " << cpu << ", tsc_ghz: " << tn.getTscGhz()
+       << ", rdtsc: " << median(rdtsc_ns) << " ns" << endl;
+  int failed = 0;
+  for (auto& [name, ns] : measured) {
+    bool ok = ns <= max_ns[name];
+    failed += !ok;
+    cout << (ok ? "ok   " : "FAIL ") << name << ": " << ns << " ns, max " << max_ns[name] << " ns" << endl;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include "tscns.hpp"
+#include "spsc_queue.hpp"
+#include "histogram.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: latency_map [threads|procs] [messages] [cpu...]
+// One-way latency between every ordered pair of the given cpus (all the cpus we may run on by default), the two ends
+// being threads or forked processes. Both stamp with rdtsc() and convert with the same TSCNS, which lives in shared
+// memory, so one-way numbers hold across processes. Per pair a -> b:
+//   stream: a pushes a message every PaceNs through a SPSC queue, b receives it
+//   ping/pong: a sends to b, which answers right away; ping is a -> b, pong b -> a, rtt/2 for comparison
+// then a matrix of the stream p50, e.g. to tell SMT siblings, cores sharing a cache and remote sockets apart.
+
+#ifdef __linux__
+
+static constexpr int64_t PaceNs = 1000;
+
+struct Message {
+  int64_t tsc;
+  int64_t seq;
+};
+
+// in memory shared by both ends
+struct Shared {
+  tscns::TSCNS<> clock;
+  tscns::SpscQueue<Message, 1024> ab;
+  tscns::SpscQueue<Message, 1024> ba;
+  atomic<int> ready;
+  tscns::Histogram<> stream, ping, pong, rtt;
+};
+
+static void pinThread(int cpu) {
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+}
+
+// both ends start together, and yield while waiting if they share a core
+static void waitOthers(Shared& s) {
+  s.ready++;
+  while (s.ready.load() < 2) this_thread::yield();
+}
+
+template <typename Q>
+static Message receive(Q& q, bool share_core) {
+  Message* m;
+  while (!(m = q.front())) {
+    if (share_core) this_thread::yield();
+  }
+  Message msg = *m;
+  q.pop();
+  return msg;
+}
+
+static int64_t elapsedNs(const Shared& s, int64_t from_tsc, int64_t to_tsc) {
+  return s.clock.tsc2ns(to_tsc) - s.clock.tsc2ns(from_tsc);
+}
+
+static void sideA(Shared& s, int cpu, int n, bool share_core) {
+  pinThread(cpu);
+  waitOthers(s);
+  int64_t pace_tsc = (int64_t)(PaceNs * s.clock.getTscGhz());
+  int64_t next = tscns::TSCNS<>::rdtsc();
+  for (int i = 0; i < n; i++) {
+    while (tscns::TSCNS<>::rdtsc() < next) {
+      if (share_core) this_thread::yield();
+    }
+    while (!s.ab.tryPush({tscns::TSCNS<>::rdtsc(), i})) this_thread::yield();
+    next += pace_tsc;
+  }
+  for (int i = 0; i < n; i++) {
+    int64_t tx = tscns::TSCNS<>::rdtsc();
+    s.ab.tryPush({tx, i});
+    Message reply = receive(s.ba, share_core);
+    int64_t rx = tscns::TSCNS<>::rdtsc();
+    s.pong.record(elapsedNs(s, reply.tsc, rx));
+    s.rtt.record(elapsedNs(s, tx, rx) / 2);
+  }
+}
+
+static void sideB(Shared& s, int cpu, int n, bool share_core) {
+  pinThread(cpu);
+  waitOthers(s);
+  for (int i = 0; i < n; i++) {
+    Message msg = receive(s.ab, share_core);
+    s.stream.record(elapsedNs(s, msg.tsc, tscns::TSCNS<>::rdtsc()));
+  }
+  for (int i = 0; i < n; i++) {
+    Message msg = receive(s.ab, share_core);
+    int64_t rx = tscns::TSCNS<>::rdtsc();
+    s.ping.record(elapsedNs(s, msg.tsc, rx));
+    s.ba.tryPush({tscns::TSCNS<>::rdtsc(), msg.seq});
+  }
+}
+
+static void runPair(Shared& s, bool procs, int a, int b, int n) {
+  new (&s.ab) tscns::SpscQueue<Message, 1024>;
+  new (&s.ba) tscns::SpscQueue<Message, 1024>;
+  s.ready = 0;
+  for (auto* h : {&s.stream, &s.ping, &s.pong, &s.rtt}) h->reset();
+  bool share_core = a == b;
+  if (!procs) {
+    thread ta(sideA, ref(s), a, n, share_core), tb(sideB, ref(s), b, n, share_core);
+    ta.join();
+    tb.join();
+    return;
+  }
+  pid_t pa = fork();
+  if (pa == 0) {
+    sideA(s, a, n, share_core);
+    _exit(0);
+  }
+  pid_t pb = fork();
+  if (pb == 0) {
+    sideB(s, b, n, share_core);
+    _exit(0);
+  }
+  waitpid(pa, nullptr, 0);
+  waitpid(pb, nullptr, 0);
+}
+
+#endif
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_latency_map_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+#ifdef __linux__
+  bool procs = argc > 1 && string(argv[1]) == "procs";
+  int n = argc > 2 ? stoi(argv[2]) : 100'000;
+  vector<int> cpus;
+  for (int i = 3; i < argc; i++) cpus.push_back(stoi(argv[i]));
+  if (cpus.empty()) {
+    cpu_set_t cpuset;
+    sched_getaffinity(0, sizeof(cpuset), &cpuset);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpuset)) cpus.push_back(cpu);
+    }
+  }
+  if (cpus.size() == 1) {
+    cout << "only cpu " << cpus[0] << " available, both ends share it" << endl;
+    cpus.push_back(cpus[0]);
+  }
+
+  void* mem = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    cerr << "mmap failed" << endl;
+    return 1;
+  }
+  Shared& s = *new (mem) Shared;
+  s.clock.init();
+
+  size_t m = cpus.size();
+  vector<vector<int64_t>> matrix(m, vector<int64_t>(m, -1));
+  cout << (procs ? "processes" : "threads") << ", messages per pair: " << n << ", one-way latency ns:" << endl;
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < m; j++) {
+      if (i == j) continue;
+      s.clock.calibrate();
+      runPair(s, procs, cpus[i], cpus[j], n);
+      matrix[i][j] = s.stream.percentile(50);
+      cout << setw(3) << cpus[i] << " -> " << setw(3) << cpus[j] << ": stream p50: " << s.stream.percentile(50)
+           << ", p99: " << s.stream.percentile(99) << ", max: " << s.stream.max()
+           << " | ping p50: " << s.ping.percentile(50) << ", p99: " << s.ping.percentile(99)
+           << " | pong p50: " << s.pong.percentile(50) << ", p99: " << s.pong.percentile(99)
+           << " | rtt/2 p50: " << s.rtt.percentile(50) << endl;
+    }
+  }
+
+  cout << "stream p50 matrix (from row to column):" << endl << "     ";
+  for (size_t j = 0; j < m; j++) cout << setw(7) << cpus[j];
+  cout << endl;
+  for (size_t i = 0; i < m; i++) {
+    cout << setw(5) << cpus[i];
+    for (size_t j = 0; j < m; j++) {
+      if (matrix[i][j] < 0) {
+        cout << setw(7) << "-";
+      } else {
+        cout << setw(7) << matrix[i][j];
+      }
+    }
+    cout << endl;
+  }
+  munmap(mem, sizeof(Shared));
+#else
+  cerr << "latency_map needs Linux" << endl;
+#endif
+  return 0;
+}
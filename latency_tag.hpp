@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <ostream>
+#include "tscns.hpp"
+#include "histogram.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Raw tsc of every stage a message went through, carried inside the message itself.
+ * Each stage stamps its own slot with one rdtsc() and one store; conversion to ns is left to LatencyAggregator in a
+ * reporting thread. A zero slot means the stage was skipped, and a new tag starts with all of them zero.
+ */
+template <int32_t kStages, typename Clock = TSCNS<>>
+struct LatencyTag
+{
+    std::array<int64_t, kStages> tsc {};
+
+    void clear() { tsc.fill(0); }
+    void stamp(int32_t stage) { tsc[stage] = Clock::rdtsc(); }
+    void stamp(int32_t stage, int64_t stage_tsc) { tsc[stage] = stage_tsc; }
+};
+
+/**
+ * @brief Per-stage and end-to-end latency histograms (in ns) of LatencyTags.
+ * The latency of a stage is the time from the previous stamped stage to it, so the first stage has none.
+ * Not thread safe: keep one per reporting thread and merge() them.
+ */
+template <int32_t kStages, typename Clock = TSCNS<>, typename H = Histogram<>>
+class LatencyAggregator
+{
+public:
+    LatencyAggregator(const Clock & clock, const std::array<const char *, kStages> & names);
+    void add(const LatencyTag<kStages, Clock> & tag);
+    void merge(const LatencyAggregator & other);
+    void reset();
+    const H & stage(int32_t stage) const { return stages_[stage]; }
+    const H & endToEnd() const { return end_to_end_; }
+    const char * name(int32_t stage) const { return names_[stage]; }
+    void print(std::ostream & os) const;
+
+private:
+    const Clock & clock_;
+    std::array<const char *, kStages> names_;
+    std::array<H, kStages> stages_;
+    H end_to_end_;
+};
+
+template <int32_t kStages, typename Clock, typename H>
+LatencyAggregator<kStages, Clock, H>::LatencyAggregator(const Clock & clock,
+                                                        const std::array<const char *, kStages> & names)
+    : clock_(clock)
+    , names_(names)
+{
+}
+
+template <int32_t kStages, typename Clock, typename H>
+void LatencyAggregator<kStages, Clock, H>::add(const LatencyTag<kStages, Clock> & tag)
+{
+    int64_t first_ns = 0, prev_ns = 0;
+    int32_t stamped = 0;
+    for(int32_t i = 0; i < kStages; i++)
+    {
+        if(tag.tsc[i] == 0)
+        {
+            continue;
+        }
+        int64_t ns = clock_.tsc2ns(tag.tsc[i]);
+        if(stamped++)
+        {
+            stages_[i].record(ns - prev_ns);
+        }
+        else
+        {
+            first_ns = ns;
+        }
+        prev_ns = ns;
+    }
+    if(stamped > 1)
+    {
+        end_to_end_.record(prev_ns - first_ns);
+    }
+}
+
+template <int32_t kStages, typename Clock, typename H>
+void LatencyAggregator<kStages, Clock, H>::merge(const LatencyAggregator & other)
+{
+    for(int32_t i = 0; i < kStages; i++)
+    {
+        stages_[i].merge(other.stages_[i]);
+    }
+    end_to_end_.merge(other.end_to_end_);
+}
+
+template <int32_t kStages, typename Clock, typename H>
+void LatencyAggregator<kStages, Clock, H>::reset()
+{
+    for(H & hist : stages_)
+    {
+        hist.reset();
+    }
+    end_to_end_.reset();
+}
+
+// One line per stage and one for end to end: count, mean, p50, p99, p99.9 and max in ns
+template <int32_t kStages, typename Clock, typename H>
+void LatencyAggregator<kStages, Clock, H>::print(std::ostream & os) const
+{
+    auto line = [&os](const char * name, const H & hist) {
+        os << name << ": count: " << hist.count() << ", mean: " << static_cast<int64_t>(hist.mean())
+           << ", p50: " << hist.percentile(50) << ", p99: " << hist.percentile(99)
+           << ", p99.9: " << hist.percentile(99.9) << ", max: " << hist.max() << std::endl;
+    };
+    for(int32_t i = 1; i < kStages; i++)
+    {
+        line(names_[i], stages_[i]);
+    }
+    line("end_to_end", end_to_end_);
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <cstring>
+#include <new>
+#include "replay_clock.hpp"
+#include "latency_tag.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Feeds LatencyAggregator tags with known tsc values and checks what lands in each histogram. ReplayClock at its
+// default 1 GHz and never set makes tsc2ns() the identity, so every expected latency is exact.
+
+using Tag = tscns::LatencyTag<4, tscns::ReplayClock>;
+using Aggregator = tscns::LatencyAggregator<4, tscns::ReplayClock>;
+
+static int failures = 0;
+
+static void expect(const char* what, const tscns::Histogram<>& hist, int64_t count, int64_t min, int64_t max,
+                   double mean) {
+  bool ok = hist.count() == count && hist.min() == min && hist.max() == max && hist.mean() == mean;
+  cout << (ok ? "ok   " : "FAIL ") << what << ": count: " << hist.count() << ", min: " << hist.min()
+       << ", max: " << hist.max() << ", mean: " << hist.mean() << " (expected " << count << ", " << min << ", "
+       << max << ", " << mean << ")" << endl;
+  failures += !ok;
+}
+
+static Tag makeTag(int64_t rx, int64_t parse, int64_t strategy, int64_t tx) {
+  Tag tag;
+  tag.stamp(0, rx);
+  tag.stamp(1, parse);
+  tag.stamp(2, strategy);
+  tag.stamp(3, tx);
+  return tag;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_latency_tag_test_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  tscns::ReplayClock clock;
+  Aggregator agg(clock, {"rx", "parse", "strategy", "tx"});
+
+  // every stage stamped: 100, 200 and 400 ns, 700 end to end
+  agg.add(makeTag(1000, 1100, 1300, 1700));
+  // parse skipped: strategy counts from rx, 500 ns, then tx 100 ns, 600 end to end
+  agg.add(makeTag(2000, 0, 2500, 2600));
+  // a single stage has no latency at all
+  agg.add(makeTag(3000, 0, 0, 0));
+
+  // a tag constructed over dirty memory and never cleared: the unstamped stages must still read as skipped
+  alignas(Tag) unsigned char buf[sizeof(Tag)];
+  memset(buf, 0x5a, sizeof(buf));
+  Tag* dirty = new (buf) Tag;
+  dirty->stamp(0, 4000);
+  agg.add(*dirty);
+
+  expect("parse", agg.stage(1), 1, 100, 100, 100.0);
+  expect("strategy", agg.stage(2), 2, 200, 500, 350.0);
+  expect("tx", agg.stage(3), 2, 100, 400, 250.0);
+  expect("end_to_end", agg.endToEnd(), 2, 600, 700, 650.0);
+
+  // merging another reporting thread's aggregator
+  Aggregator other(clock, {"rx", "parse", "strategy", "tx"});
+  other.add(makeTag(5000, 5050, 5100, 5150));
+  agg.merge(other);
+  expect("merged parse", agg.stage(1), 2, 50, 100, 75.0);
+  expect("merged end_to_end", agg.endToEnd(), 3, 150, 700, 1450.0 / 3);
+
+  agg.print(cout);
+  cout << (failures ? "failed" : "passed") << endl;
+  return failures != 0;
+}
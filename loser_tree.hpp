@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+namespace tscns {
+
+/**
+ * @brief Tournament tree of losers over k int64 keys, for k-way merging.
+ * The winner is the smallest key (ties go to the smaller leaf index). Changing the key of the current winner and
+ * replaying costs log2(k) compares; after changing other keys the tree must be rebuilt, which costs k.
+ */
+class LoserTree
+{
+public:
+    static constexpr int64_t Inf = std::numeric_limits<int64_t>::max();
+
+    explicit LoserTree(int32_t k);
+    int32_t size() const { return k_; }
+    void setKey(int32_t leaf, int64_t key) { keys_[leaf] = key; }
+    int64_t key(int32_t leaf) const { return keys_[leaf]; }
+    void build();
+    void replay(int32_t leaf);
+    void update(int32_t leaf, int64_t key);
+    int32_t winner() const { return tree_[0]; }
+    int64_t winnerKey() const { return keys_[tree_[0]]; }
+    int64_t runnerUpKey() const;
+
+private:
+    bool less(int32_t a, int32_t b) const { return keys_[a] < keys_[b] || (keys_[a] == keys_[b] && a < b); }
+
+    int32_t k_;
+    int32_t n_;
+    // k rounded up to a power of 2, the extra leaves stay at Inf
+    std::vector<int64_t> keys_;
+    std::vector<int32_t> tree_;
+    // tree_[0] is the winner, tree_[1..n_) the loser of each match
+};
+
+inline LoserTree::LoserTree(int32_t k)
+    : k_(k)
+    , n_(1)
+{
+    while(n_ < k)
+    {
+        n_ <<= 1;
+    }
+    keys_.assign(n_, Inf);
+    tree_.assign(n_, 0);
+    build();
+}
+
+inline void LoserTree::build()
+{
+    std::vector<int32_t> winners(n_ * 2);
+    for(int32_t i = 0; i < n_; i++)
+    {
+        winners[n_ + i] = i;
+    }
+    for(int32_t node = n_ - 1; node > 0; node--)
+    {
+        int32_t a = winners[node * 2], b = winners[node * 2 + 1];
+        bool a_wins = less(a, b);
+        winners[node] = a_wins ? a : b;
+        tree_[node] = a_wins ? b : a;
+    }
+    tree_[0] = n_ > 1 ? winners[1] : 0;
+}
+
+// Replay the matches from leaf to the root, only valid if leaf is the current winner
+inline void LoserTree::replay(int32_t leaf)
+{
+    int32_t winner = leaf;
+    for(int32_t node = (leaf + n_) >> 1; node > 0; node >>= 1)
+    {
+        if(less(tree_[node], winner))
+        {
+            std::swap(tree_[node], winner);
+        }
+    }
+    tree_[0] = winner;
+}
+
+// Smallest key other than the winner's: the best of the losers the winner beat on its way up. Everything of the winner's
+// leaf up to this key can be taken without replaying.
+inline int64_t LoserTree::runnerUpKey() const
+{
+    int64_t key = Inf;
+    for(int32_t node = (tree_[0] + n_) >> 1; node > 0; node >>= 1)
+    {
+        key = std::min(key, keys_[tree_[node]]);
+    }
+    return key;
+}
+
+inline void LoserTree::update(int32_t leaf, int64_t key)
+{
+    keys_[leaf] = key;
+    replay(leaf);
+}
+
+}
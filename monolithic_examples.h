@@ -9,6 +9,29 @@ extern "C" {
 
 int tscns_test_main(int argc, const char** argv);
 int tscns_alt_test_main(int argc, const char** argv);
+int tscns_hlc_bench_main(int argc, const char** argv);
+int tscns_idgen_bench_main(int argc, const char** argv);
+int tscns_jitter_meter_main(int argc, const char** argv);
+int tscns_reorder_bench_main(int argc, const char** argv);
+int tscns_kway_merge_bench_main(int argc, const char** argv);
+int tscns_tsclog_bench_main(int argc, const char** argv);
+int tscns_tsclog_decompress_main(int argc, const char** argv);
+int tscns_tsc_convert_main(int argc, const char** argv);
+int tscns_calib_replay_main(int argc, const char** argv);
+int tscns_audit_report_main(int argc, const char** argv);
+int tscns_replay_bench_main(int argc, const char** argv);
+int tscns_pcapng_bench_main(int argc, const char** argv);
+int tscns_kernel_ts_bench_main(int argc, const char** argv);
+int tscns_offset_probe_main(int argc, const char** argv);
+int tscns_latency_map_main(int argc, const char** argv);
+int tscns_seqlock_bench_main(int argc, const char** argv);
+int tscns_seqlock_stress_main(int argc, const char** argv);
+int tscns_tsan_stress_main(int argc, const char** argv);
+int tscns_latency_guard_main(int argc, const char** argv);
+int tscns_latency_tag_test_main(int argc, const char** argv);
+int tscns_watchdog_test_main(int argc, const char** argv);
+int tscns_global_demo_main(int argc, const char** argv);
+int tscns_c_demo_main(int argc, const char** argv);
 
 #ifdef __cplusplus
 }
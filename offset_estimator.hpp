@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <array>
+#include <limits>
+
+namespace tscns {
+
+// Probe of the offset exchange: the client sends seq and t1, the server echoes them with t2 (received) and t3 (sent)
+struct OffsetMessage
+{
+    uint64_t seq;
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+};
+
+/**
+ * @brief The four timestamps of one exchange, NTP style: t1 client send, t2 server receive, t3 server send (server
+ * clock), t4 client receive (client clock).
+ */
+struct OffsetSample
+{
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+    int64_t t4;
+
+    // server clock - client clock, exact if both ways took as long
+    int64_t offset() const { return ((t2 - t1) + (t3 - t4)) / 2; }
+    // round trip, minus the time spent in the server
+    int64_t delay() const { return (t4 - t1) - (t3 - t2); }
+};
+
+struct OffsetEstimate
+{
+    int64_t offset_ns;
+    int64_t uncertainty_ns;
+    // the true offset is within offset_ns +- uncertainty_ns, whatever the asymmetry of the two ways
+    int64_t delay_ns;
+    int32_t samples;
+    // in the window, 0 if there's no estimate yet
+};
+
+/**
+ * @brief Clock offset estimator over two-way exchanges: the sample with the smallest delay among the last kWindow
+ * ones wins (NTP's clock filter), as queueing and scheduling only ever add delay, and its offset can't be off by more
+ * than half of its delay. A larger window finds quieter samples but lets the clocks drift apart within it.
+ */
+template <int32_t kWindow = 16>
+class OffsetEstimator
+{
+public:
+    void add(const OffsetSample & sample);
+    OffsetEstimate estimate() const;
+    void reset() { count_ = 0; }
+
+private:
+    std::array<OffsetSample, kWindow> window_;
+    int64_t count_ = 0;
+};
+
+template <int32_t kWindow>
+void OffsetEstimator<kWindow>::add(const OffsetSample & sample)
+{
+    if(sample.delay() < 0)
+    {
+        // the clocks were recalibrated in the middle of the exchange, nothing to learn from it
+        return;
+    }
+    window_[count_++ % kWindow] = sample;
+}
+
+template <int32_t kWindow>
+OffsetEstimate OffsetEstimator<kWindow>::estimate() const
+{
+    int32_t n = static_cast<int32_t>(count_ < kWindow ? count_ : kWindow);
+    if(n == 0)
+    {
+        return OffsetEstimate {0, std::numeric_limits<int64_t>::max(), 0, 0};
+    }
+    const OffsetSample * best = &window_[0];
+    for(int32_t i = 1; i < n; i++)
+    {
+        if(window_[i].delay() < best->delay())
+        {
+            best = &window_[i];
+        }
+    }
+    int64_t delay = best->delay();
+    return OffsetEstimate {best->offset(), (delay + 1) / 2, delay, n};
+}
+
+}
@@ -0,0 +1,297 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <functional>
+#include "tscns.hpp"
+#include "offset_estimator.hpp"
+#include "spsc_queue.hpp"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage:
+//   offset_probe udp-server port
+//   offset_probe udp-client server_ip port [probes] [interval_us]
+//   offset_probe shm-server name
+//   offset_probe shm-client name [probes] [interval_us]
+//     measure the offset of the server's clock from the client's, each being rdns() of its own TSCNS, by four
+//     timestamp exchanges over UDP or over a shared memory channel (name as for shm_open, e.g. /tscns_offset)
+//   offset_probe local [probes] [interval_us]
+//     both ends in this process with a TSCNS each, over loopback UDP then shared memory; as both clocks read the same
+//     tsc, the true offset is known and printed alongside
+
+#ifdef __linux__
+
+using Clock = tscns::TSCNS<>;
+using Exchange = function<bool(tscns::OffsetMessage&)>;
+// sends the request, waits for the reply in place, false if it's lost
+
+struct ShmChannel {
+  tscns::SpscQueue<tscns::OffsetMessage, 64> requests;
+  tscns::SpscQueue<tscns::OffsetMessage, 64> replies;
+};
+
+static bool udpAddr(const char* ip, int port, sockaddr_in& addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+    cerr << "invalid IPv4 address: " << ip << endl;
+    return false;
+  }
+  return true;
+}
+
+// -1 with the error printed if ip isn't an address or the socket can't be created
+static int udpSocket(const char* ip, int port, sockaddr_in& addr) {
+  if (!udpAddr(ip, port, addr)) return -1;
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) cerr << "socket: " << strerror(errno) << endl;
+  return fd;
+}
+
+static void serveUdp(Clock& clock, int fd, const atomic<bool>& running) {
+  tscns::OffsetMessage msg;
+  sockaddr_in peer;
+  socklen_t peer_len;
+  timeval timeout{0, 100'000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  while (running.load()) {
+    peer_len = sizeof(peer); // value-result: recvfrom leaves the length of the last sender in it
+    if (recvfrom(fd, &msg, sizeof(msg), 0, (sockaddr*)&peer, &peer_len) != sizeof(msg)) continue;
+    msg.t2 = clock.rdns();
+    msg.t3 = clock.rdns();
+    sendto(fd, &msg, sizeof(msg), 0, (sockaddr*)&peer, peer_len);
+    clock.calibrate();
+  }
+}
+
+static Exchange udpClient(Clock& clock, int fd, const sockaddr_in& server) {
+  timeval timeout{0, 100'000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return [&clock, fd, server](tscns::OffsetMessage& msg) {
+    uint64_t seq = msg.seq;
+    msg.t1 = clock.rdns();
+    sendto(fd, &msg, sizeof(msg), 0, (const sockaddr*)&server, sizeof(server));
+    while (recv(fd, &msg, sizeof(msg), 0) == sizeof(msg)) {
+      if (msg.seq == seq) return true;
+      // a late reply to a probe we gave up on
+    }
+    return false;
+  };
+}
+
+static ShmChannel* mapChannel(const char* name, bool create) {
+  int fd = shm_open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+  if (fd < 0 || (create && ftruncate(fd, sizeof(ShmChannel)) != 0)) return nullptr;
+  void* p = mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return nullptr;
+  return create ? new (p) ShmChannel : (ShmChannel*)p;
+}
+
+static void serveShm(Clock& clock, ShmChannel& channel, const atomic<bool>& running) {
+  while (running.load()) {
+    tscns::OffsetMessage* req = channel.requests.front();
+    if (!req) {
+      clock.calibrate();
+      this_thread::yield();
+      continue;
+    }
+    int64_t t2 = clock.rdns();
+    tscns::OffsetMessage msg = *req;
+    channel.requests.pop();
+    msg.t2 = t2;
+    msg.t3 = clock.rdns();
+    channel.replies.tryPush(msg);
+  }
+}
+
+static Exchange shmClient(Clock& clock, ShmChannel& channel) {
+  return [&clock, &channel](tscns::OffsetMessage& msg) {
+    uint64_t seq = msg.seq;
+    msg.t1 = clock.rdns();
+    if (!channel.requests.tryPush(msg)) return false;
+    int64_t expire = msg.t1 + 100'000'000;
+    while (clock.rdns() < expire) {
+      tscns::OffsetMessage* reply = channel.replies.front();
+      if (!reply) {
+        this_thread::yield();
+        continue;
+      }
+      bool mine = reply->seq == seq;
+      msg = *reply;
+      channel.replies.pop();
+      if (mine) return true;
+    }
+    return false;
+  };
+}
+
+// reference: true server - client offset when known, i.e. both clocks in this process
+static void probe(Clock& clock, const Exchange& exchange, int probes, int64_t interval_us,
+                  const function<int64_t()>& reference = nullptr) {
+  tscns::OffsetEstimator<> estimator;
+  int lost = 0;
+  for (int i = 0; i < probes; i++) {
+    tscns::OffsetMessage msg{(uint64_t)i, 0, 0, 0};
+    if (exchange(msg)) {
+      estimator.add({msg.t1, msg.t2, msg.t3, clock.rdns()});
+    } else {
+      lost++;
+    }
+    clock.calibrate();
+    if ((i + 1) % max(probes / 10, 1) == 0) {
+      auto est = estimator.estimate();
+      cout << "probes: " << i + 1 << ", lost: " << lost << ", offset: " << est.offset_ns << " +- "
+           << est.uncertainty_ns << " ns, min delay: " << est.delay_ns << " ns";
+      if (reference) cout << ", true offset: " << reference();
+      cout << endl;
+    }
+    this_thread::sleep_for(chrono::microseconds(interval_us));
+  }
+}
+
+static int local(int probes, int64_t interval_us) {
+  Clock client, server;
+  client.init();
+  server.init();
+  auto reference = [&]() {
+    int64_t tsc = Clock::rdtsc();
+    return server.tsc2ns(tsc) - client.tsc2ns(tsc);
+  };
+  atomic<bool> running{true};
+
+  sockaddr_in server_addr, client_addr;
+  int server_fd = udpSocket("127.0.0.1", 0, server_addr);
+  if (server_fd < 0) return 1;
+  socklen_t len = sizeof(server_addr);
+  bool bound = bind(server_fd, (sockaddr*)&server_addr, sizeof(server_addr)) == 0;
+  if (!bound || getsockname(server_fd, (sockaddr*)&server_addr, &len) != 0) {
+    cerr << (bound ? "getsockname: " : "bind: ") << strerror(errno) << endl;
+    close(server_fd);
+    return 1;
+  }
+  int client_fd = udpSocket("127.0.0.1", 0, client_addr);
+  if (client_fd < 0) {
+    close(server_fd);
+    return 1;
+  }
+  thread udp_server([&]() { serveUdp(server, server_fd, running); });
+  cout << "udp loopback:" << endl;
+  probe(client, udpClient(client, client_fd, server_addr), probes, interval_us, reference);
+  running = false;
+  udp_server.join();
+  close(server_fd);
+  close(client_fd);
+
+  running = true;
+  ShmChannel channel;
+  thread shm_server([&]() { serveShm(server, channel, running); });
+  cout << "shared memory:" << endl;
+  probe(client, shmClient(client, channel), probes, interval_us, reference);
+  running = false;
+  shm_server.join();
+  return 0;
+}
+
+#endif
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_offset_probe_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+#ifdef __linux__
+  string mode = argc > 1 ? argv[1] : "";
+  int arg = mode == "udp-client" ? 4 : 3;
+  if (mode == "local") arg = 2;
+  int probes = argc > arg ? stoi(argv[arg]) : 1000;
+  int64_t interval_us = argc > arg + 1 ? stoll(argv[arg + 1]) : 1000;
+  if (mode == "local") return local(probes, interval_us);
+
+  Clock clock;
+  clock.init();
+  atomic<bool> running{true};
+  if (mode == "udp-server" && argc > 2) {
+    sockaddr_in addr;
+    int fd = udpSocket("0.0.0.0", stoi(argv[2]), addr);
+    if (fd < 0) return 1;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+      cerr << "bind: " << strerror(errno) << endl;
+      close(fd);
+      return 1;
+    }
+    serveUdp(clock, fd, running);
+    close(fd);
+    return 0;
+  }
+  if (mode == "udp-client" && argc > 3) {
+    sockaddr_in server, any;
+    if (!udpAddr(argv[2], stoi(argv[3]), server)) return 1;
+    int fd = udpSocket("0.0.0.0", 0, any);
+    if (fd < 0) return 1;
+    probe(clock, udpClient(clock, fd, server), probes, interval_us);
+    close(fd);
+    return 0;
+  }
+  if ((mode == "shm-server" || mode == "shm-client") && argc > 2) {
+    bool server = mode == "shm-server";
+    ShmChannel* channel = mapChannel(argv[2], server);
+    if (!channel) {
+      cerr << "shm: " << strerror(errno) << endl;
+      return 1;
+    }
+    if (server) {
+      serveShm(clock, *channel, running);
+    } else {
+      probe(clock, shmClient(clock, *channel), probes, interval_us);
+    }
+    return 0;
+  }
+  cerr << "usage: " << argv[0] << " udp-server port" << endl
+       << "       " << argv[0] << " udp-client server_ip port [probes] [interval_us]" << endl
+       << "       " << argv[0] << " shm-server name" << endl
+       << "       " << argv[0] << " shm-client name [probes] [interval_us]" << endl
+       << "       " << argv[0] << " local [probes] [interval_us]" << endl;
+  return 1;
+#else
+  cerr << "offset_probe needs Linux" << endl;
+  return 1;
+#endif
+}
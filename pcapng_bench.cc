@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include "pcapng_writer.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// A capture thread stamps synthetic packets (64 to 1514 bytes) with rdtsc() and hands them to a PcapngWriter as fast
+// as it can, pausing only when the writer falls behind; then the file is read back to check every block and that the
+// ns timestamps are increasing. The synchronous PcapngFile is measured on its own as well.
+
+static tscns::TSCNS<> tn;
+
+// Number of packets in the file, -1 if it's malformed or their timestamps go backwards
+static int64_t verify(const char* path) {
+  ifstream in(path, ios::binary);
+  vector<char> buf((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  size_t pos = 0;
+  int64_t packets = 0, last_ns = 0;
+  while (pos + 12 <= buf.size()) {
+    uint32_t type, len, trailer;
+    memcpy(&type, &buf[pos], 4);
+    memcpy(&len, &buf[pos + 4], 4);
+    if (len < 12 || len % 4 || pos + len > buf.size()) return -1;
+    memcpy(&trailer, &buf[pos + len - 4], 4);
+    if (trailer != len) return -1;
+    if (type == 6) {
+      uint32_t hi, lo;
+      memcpy(&hi, &buf[pos + 12], 4);
+      memcpy(&lo, &buf[pos + 16], 4);
+      int64_t ns = (int64_t)((uint64_t)hi << 32 | lo);
+      if (ns < last_ns) return -1;
+      last_ns = ns;
+      packets++;
+    }
+    pos += len;
+  }
+  return pos == buf.size() ? packets : -1;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_pcapng_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  const char* path = argc > 1 ? argv[1] : "tscns_bench.pcapng";
+  const int N = argc > 2 ? stoi(argv[2]) : 5'000'000;
+  tn.init();
+
+  vector<char> payload(1514);
+  for (size_t i = 0; i < payload.size(); i++) payload[i] = (char)i;
+  vector<uint32_t> sizes(4096);
+  uint64_t x = 88172645463325252ULL;
+  for (auto& s : sizes) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    s = 64 + x % (1514 - 64 + 1);
+  }
+
+  {
+    tscns::PcapngFile file;
+    file.open(path);
+    int64_t t0 = tn.rdns();
+    for (int i = 0; i < N; i++) file.writePacket(t0 + i, payload.data(), sizes[i & 4095], sizes[i & 4095]);
+    file.close();
+    int64_t t1 = tn.rdns();
+    cout << std::setprecision(3) << fixed << "PcapngFile: " << N * 1e3 / (t1 - t0) << " Mpps" << endl;
+  }
+
+  tscns::PcapngWriter<> writer(tn);
+  if (!writer.start(path)) {
+    cerr << "can't open " << path << endl;
+    return 1;
+  }
+  int64_t retries = 0;
+  int64_t t0 = tn.rdns();
+  for (int i = 0; i < N; i++) {
+    while (!writer.capture(tn.rdtsc(), payload.data(), sizes[i & 4095])) {
+      retries++;
+      std::this_thread::yield();
+    }
+  }
+  writer.stop();
+  int64_t t1 = tn.rdns();
+  int64_t packets = verify(path);
+  cout << "PcapngWriter: " << N * 1e3 / (t1 - t0) << " Mpps, " << (double)(t1 - t0) / N
+       << " ns/packet, queue full: " << retries << ", packets in file: " << packets
+       << (packets == N ? " (ok)" : " (BAD)") << endl;
+  return packets == N ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include "tscns.hpp"
+#include "spsc_queue.hpp"
+
+namespace tscns {
+
+/**
+ * @brief pcapng file writer with nanosecond timestamps (if_tsresol = 9), for packets captured in user space.
+ * Blocks are assembled in a large buffer that goes out in one fwrite whenever it fills up, so the file sees few big
+ * writes. Synchronous: use it directly from the thread that owns the file, or through PcapngWriter below.
+ * One section, one interface; all integers in native byte order, as pcapng allows (readers check the byte order
+ * magic).
+ */
+class PcapngFile
+{
+public:
+    static constexpr uint16_t LinkTypeEthernet = 1;
+
+    ~PcapngFile() { close(); }
+    bool open(const char * path, uint32_t snaplen = 65535, uint16_t link_type = LinkTypeEthernet,
+              size_t buffer_size = 4 << 20);
+    void close();
+    void writePacket(int64_t ns, const void * data, uint32_t caplen, uint32_t origlen);
+    void flush();
+
+private:
+    template <typename T>
+    void put(const T & v)
+    {
+        memcpy(out_.data() + used_, &v, sizeof(v));
+        used_ += sizeof(v);
+    }
+
+    FILE * file_ = nullptr;
+    std::vector<char> out_;
+    size_t used_ = 0;
+};
+
+inline bool PcapngFile::open(const char * path, uint32_t snaplen, uint16_t link_type, size_t buffer_size)
+{
+    close();
+    if(!(file_ = fopen(path, "wb")))
+    {
+        return false;
+    }
+    setvbuf(file_, nullptr, _IONBF, 0);
+    // we do our own buffering
+    out_.resize(std::max<size_t>(buffer_size, 1 << 16));
+    used_ = 0;
+    // Section Header Block: no options, unknown section length
+    put(uint32_t(0x0a0d0d0a));
+    put(uint32_t(28));
+    put(uint32_t(0x1a2b3c4d));
+    put(uint16_t(1));
+    put(uint16_t(0));
+    put(int64_t(-1));
+    put(uint32_t(28));
+    // Interface Description Block: if_tsresol = 9, i.e. timestamps in ns, then opt_endofopt
+    put(uint32_t(1));
+    put(uint32_t(32));
+    put(link_type);
+    put(uint16_t(0));
+    put(snaplen);
+    put(uint16_t(9));
+    put(uint16_t(1));
+    put(uint8_t(9));
+    put(uint8_t(0));
+    put(uint16_t(0));
+    put(uint32_t(0));
+    put(uint32_t(32));
+    return true;
+}
+
+inline void PcapngFile::close()
+{
+    if(file_)
+    {
+        flush();
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+// Enhanced Packet Block on interface 0, ns since the Unix epoch
+inline void PcapngFile::writePacket(int64_t ns, const void * data, uint32_t caplen, uint32_t origlen)
+{
+    uint32_t padded = (caplen + 3) & ~3u;
+    uint32_t block_len = 32 + padded;
+    if(used_ + block_len > out_.size())
+    {
+        flush();
+        if(block_len > out_.size())
+        {
+            out_.resize(block_len);
+        }
+    }
+    put(uint32_t(6));
+    put(block_len);
+    put(uint32_t(0));
+    put(static_cast<uint32_t>(static_cast<uint64_t>(ns) >> 32));
+    put(static_cast<uint32_t>(ns));
+    put(caplen);
+    put(origlen);
+    memcpy(out_.data() + used_, data, caplen);
+    memset(out_.data() + used_ + caplen, 0, padded - caplen);
+    used_ += padded;
+    put(block_len);
+}
+
+inline void PcapngFile::flush()
+{
+    if(used_)
+    {
+        fwrite(out_.data(), 1, used_, file_);
+        used_ = 0;
+    }
+}
+
+/**
+ * @brief Asynchronous pcapng writer fed with raw rdtsc() capture times.
+ * The capture thread copies each packet with its tsc into a slot of a SPSC queue and goes back to the wire; the
+ * writer thread takes the packets by batches, converts the whole batch through one getParam() snapshot of the clock
+ * and hands them to a PcapngFile. Packets longer than a slot are truncated (caplen < origlen), and capture() drops
+ * the packet and counts it when the writer falls behind by kSlots packets, it never blocks.
+ * Single producer: use one writer (one file) per capturing thread.
+ */
+template <typename Clock = TSCNS<>, uint32_t kSlotSize = 2048, uint32_t kSlots = 8192>
+class PcapngWriter
+{
+public:
+    static constexpr uint32_t SnapLen = kSlotSize - 16;
+    static constexpr uint32_t BatchSize = 256;
+
+    explicit PcapngWriter(const Clock & clock)
+        : clock_(clock)
+        , queue_(new Queue)
+    {
+    }
+    ~PcapngWriter() { stop(); }
+    bool start(const char * path, uint16_t link_type = PcapngFile::LinkTypeEthernet, int64_t poll_interval_ns = 100'000);
+    void stop();
+    bool capture(int64_t tsc, const void * data, uint32_t len);
+    int64_t droppedPackets() const { return dropped_.load(std::memory_order_relaxed); }
+    int64_t writtenPackets() const { return written_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        int64_t tsc;
+        uint32_t caplen;
+        uint32_t origlen;
+        char data[SnapLen];
+    };
+    using Queue = SpscQueue<Slot, kSlots>;
+
+    void writer(int64_t poll_interval_ns);
+    bool drain();
+
+    const Clock & clock_;
+    std::unique_ptr<Queue> queue_;
+    std::atomic<int64_t> dropped_ {0};
+    std::atomic<int64_t> written_ {0};
+
+    // writer thread only
+    PcapngFile file_;
+    std::atomic<bool> running_ {false};
+    std::thread thread_;
+};
+
+template <typename Clock, uint32_t kSlotSize, uint32_t kSlots>
+bool PcapngWriter<Clock, kSlotSize, kSlots>::start(const char * path, uint16_t link_type, int64_t poll_interval_ns)
+{
+    if(running_.load() || !file_.open(path, SnapLen, link_type))
+    {
+        return false;
+    }
+    running_.store(true);
+    thread_ = std::thread(&PcapngWriter::writer, this, poll_interval_ns);
+    return true;
+}
+
+// Write out everything captured so far and close the file
+template <typename Clock, uint32_t kSlotSize, uint32_t kSlots>
+void PcapngWriter<Clock, kSlotSize, kSlots>::stop()
+{
+    if(!running_.exchange(false))
+    {
+        return;
+    }
+    thread_.join();
+    file_.close();
+}
+
+template <typename Clock, uint32_t kSlotSize, uint32_t kSlots>
+TSCNS_FORCE_INLINE bool PcapngWriter<Clock, kSlotSize, kSlots>::capture(int64_t tsc, const void * data, uint32_t len)
+{
+    Slot * slot = queue_->alloc();
+    if(!slot)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slot->tsc = tsc;
+    slot->origlen = len;
+    slot->caplen = std::min(len, SnapLen);
+    memcpy(slot->data, data, slot->caplen);
+    queue_->push();
+    return true;
+}
+
+template <typename Clock, uint32_t kSlotSize, uint32_t kSlots>
+void PcapngWriter<Clock, kSlotSize, kSlots>::writer(int64_t poll_interval_ns)
+{
+    while(true)
+    {
+        bool running = running_.load();
+        // check before draining: once stopped, the last drain still gets everything captured before stop()
+        bool busy = drain();
+        if(!running)
+        {
+            break;
+        }
+        if(!busy)
+        {
+            file_.flush();
+            std::this_thread::sleep_for(std::chrono::nanoseconds(poll_interval_ns));
+        }
+    }
+}
+
+template <typename Clock, uint32_t kSlotSize, uint32_t kSlots>
+bool PcapngWriter<Clock, kSlotSize, kSlots>::drain()
+{
+    bool busy = false;
+    while(true)
+    {
+        // the slots stay in the queue until written, so there's no copy
+        uint32_t n = std::min(queue_->readable(), BatchSize);
+        if(n == 0)
+        {
+            return busy;
+        }
+        busy = true;
+        int64_t ns[BatchSize];
+        TscParam param = clock_.getParam();
+        for(uint32_t i = 0; i < n; i++)
+        {
+            ns[i] = param.tsc2ns(queue_->peek(i)->tsc);
+        }
+        for(uint32_t i = 0; i < n; i++)
+        {
+            const Slot * slot = queue_->peek(i);
+            file_.writePacket(ns[i], slot->data, slot->caplen, slot->origlen);
+        }
+        queue_->pop(n);
+        written_.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+}
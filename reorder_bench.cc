@@ -0,0 +1,92 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include "reorder_buffer.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: reorder_bench [producers] [events_per_producer]
+// Every producer pushes rdtsc() stamped events into its own lane as fast as it can, the main thread merges them and
+// checks the output is ordered.
+
+static tscns::TSCNS<> tn;
+
+struct Msg {
+  int64_t seq;
+  int64_t payload;
+};
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_reorder_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int producers = argc > 1 ? stoi(argv[1]) : 8;
+  const int64_t N = argc > 2 ? stoll(argv[2]) : 10000000;
+  tn.init();
+
+  tscns::ReorderBuffer<Msg> rb(producers);
+  std::atomic<int> ready{0};
+  vector<thread> thrs;
+  for (int p = 0; p < producers; p++) {
+    thrs.emplace_back([&, p]() {
+      ready++;
+      while (ready.load() <= producers)
+        ;
+      for (int64_t i = 0; i < N; i++) {
+        while (!rb.push(p, tn.rdtsc(), Msg{i, p}))
+          ;
+      }
+      rb.close(p);
+    });
+  }
+  while (ready.load() < producers)
+    ;
+
+  int64_t total = 0, unordered = 0, last_tsc = 0;
+  vector<int64_t> next_seq(producers);
+  int64_t t0 = tn.rdns();
+  ready++;
+  while (total < N * producers) {
+    total += rb.poll([&](int32_t lane, int64_t tsc, const Msg& msg) {
+      if (tsc < last_tsc || msg.seq != next_seq[lane]) unordered++;
+      next_seq[lane] = msg.seq + 1;
+      last_tsc = tsc;
+    });
+  }
+  int64_t t1 = tn.rdns();
+  for (auto& thr : thrs) thr.join();
+
+  cout << std::setprecision(3) << fixed << "producers: " << producers << ", events: " << total
+       << ", Mevents/s: " << total * 1000.0 / (t1 - t0) << ", ns/event: " << (double)(t1 - t0) / total
+       << ", unordered: " << unordered << endl;
+
+  return 0;
+}
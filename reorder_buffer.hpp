@@ -0,0 +1,184 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <memory>
+#include "tscns.hpp"
+#include "spsc_queue.hpp"
+#include "loser_tree.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Merges events from several producer threads into one stream ordered by tsc, without locks.
+ * Each producer owns a lane (a SPSC queue plus a watermark) and pushes events with non-decreasing tsc. The watermark
+ * is the producer's promise that no event older than it will come, it advances with every push and can be advanced
+ * without an event by heartbeat(), so a quiet producer doesn't hold the stream up.
+ *
+ * The consumer calls poll(), which merges the lanes with a loser tree and emits an event only once no lane can still
+ * produce an older one, i.e. its tsc is not above the watermark of any empty lane. With lateness_tsc > 0, a lane whose
+ * watermark is more than lateness_tsc behind rdtsc() is not waited for: events it pushes afterwards may come out of
+ * order, they're emitted as they come and counted by lateEvents().
+ */
+template <typename T, uint32_t kLaneSize = 4096, typename Clock = TSCNS<>, int32_t kCachelineSize = 64>
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(int32_t lanes, int64_t lateness_tsc = 0);
+
+    // producer side, one thread per lane
+    bool push(int32_t lane, int64_t tsc, const T & value);
+    void heartbeat(int32_t lane, int64_t tsc);
+    void close(int32_t lane);
+
+    // consumer side: f(lane, tsc, value) for each event ready, at most max_events of them; returns how many
+    template <typename F>
+    size_t poll(F && f, size_t max_events = std::numeric_limits<size_t>::max());
+    int64_t lateEvents() const { return late_events_; }
+
+private:
+    struct Event
+    {
+        int64_t tsc;
+        T value;
+    };
+
+    struct Lane
+    {
+        SpscQueue<Event, kLaneSize, kCachelineSize> queue;
+        alignas(kCachelineSize) std::atomic<int64_t> watermark {0};
+    };
+
+    static constexpr int64_t ClosedWatermark = std::numeric_limits<int64_t>::max() >> 2;
+
+    int64_t laneKey(int32_t lane, int64_t stale_tsc);
+
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    LoserTree tree_;
+    int64_t lateness_tsc_;
+    int64_t last_tsc_ = 0;
+    int64_t late_events_ = 0;
+};
+
+template <typename T, uint32_t kLaneSize, typename Clock, int32_t kCachelineSize>
+ReorderBuffer<T, kLaneSize, Clock, kCachelineSize>::ReorderBuffer(int32_t lanes, int64_t lateness_tsc)
+    : tree_(lanes)
+    , lateness_tsc_(lateness_tsc)
+{
+    for(int32_t i = 0; i < lanes; i++)
+    {
+        lanes_.emplace_back(new Lane);
+    }
+}
+
+// Returns false if the lane is full, the consumer isn't keeping up
+template <typename T, uint32_t kLaneSize, typename Clock, int32_t kCachelineSize>
+bool ReorderBuffer<T, kLaneSize, Clock, kCachelineSize>::push(int32_t lane, int64_t tsc, const T & value)
+{
+    Lane & l = *lanes_[lane];
+    Event * event = l.queue.alloc();
+    if(!event)
+    {
+        return false;
+    }
+    event->tsc = tsc;
+    event->value = value;
+    l.queue.push();
+    l.watermark.store(tsc, std::memory_order_release);
+    return true;
+}
+
+// Promise no event older than tsc will be pushed to this lane
+template <typename T, uint32_t kLaneSize, typename Clock, int32_t kCachelineSize>
+void ReorderBuffer<T, kLaneSize, Clock, kCachelineSize>::heartbeat(int32_t lane, int64_t tsc)
+{
+    lanes_[lane]->watermark.store(tsc, std::memory_order_release);
+}
+
+// No more events from this lane
+template <typename T, uint32_t kLaneSize, typename Clock, int32_t kCachelineSize>
+void ReorderBuffer<T, kLaneSize, Clock, kCachelineSize>::close(int32_t lane)
+{
+    lanes_[lane]->watermark.store(ClosedWatermark, std::memory_order_release);
+}
+
+// Key of a lane in the tree: tsc * 2 of its first event, or watermark * 2 + 1 if it's empty, so that on equal tsc
+// events win over watermarks; an empty lane that's closed or too far behind doesn't hold anything up.
+template <typename T, uint32_t kLaneSize, typename Clock, int32_t kCachelineSize>
+int64_t ReorderBuffer<T, kLaneSize, Clock, kCachelineSize>::laneKey(int32_t lane, int64_t stale_tsc)
+{
+    Lane & l = *lanes_[lane];
+    int64_t watermark = l.watermark.load(std::memory_order_acquire);
+    // watermark is read first: any event we find after it is not older than it
+    if(Event * event = l.queue.front())
+    {
+        return event->tsc * 2;
+    }
+    if(watermark == ClosedWatermark || watermark < stale_tsc)
+    {
+        return LoserTree::Inf;
+    }
+    return watermark * 2 + 1;
+}
+
+template <typename T, uint32_t kLaneSize, typename Clock, int32_t kCachelineSize>
+template <typename F>
+size_t ReorderBuffer<T, kLaneSize, Clock, kCachelineSize>::poll(F && f, size_t max_events)
+{
+    int64_t stale_tsc = lateness_tsc_ > 0 ? Clock::rdtsc() - lateness_tsc_ : std::numeric_limits<int64_t>::min();
+    for(int32_t i = 0; i < tree_.size(); i++)
+    {
+        tree_.setKey(i, laneKey(i, stale_tsc));
+    }
+    tree_.build();
+    // any lane may have changed since the last poll, so rebuild; from here on only the winner changes
+    size_t n = 0;
+    while(n < max_events)
+    {
+        int64_t key = tree_.winnerKey();
+        if(key == LoserTree::Inf || (key & 1))
+        {
+            // the oldest thing around is the watermark of an empty lane, wait for it to move
+            break;
+        }
+        int32_t lane = tree_.winner();
+        Lane & l = *lanes_[lane];
+        Event * event = l.queue.front();
+        if(event->tsc < last_tsc_)
+        {
+            late_events_++;
+        }
+        else
+        {
+            last_tsc_ = event->tsc;
+        }
+        f(lane, event->tsc, event->value);
+        l.queue.pop();
+        n++;
+        tree_.update(lane, laneKey(lane, stale_tsc));
+    }
+    return n;
+}
+
+}
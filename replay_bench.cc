@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include "replay_clock.hpp"
+#include "idgen.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// A toy strategy written once against its clock, replayed over synthetic market data: with ReplayClock every run
+// must take the same decisions at the same times (same digest), as fast as the CPU goes; with TSCNS the decisions
+// depend on how fast the replay happened to run.
+
+struct Event {
+  int64_t ns;
+  int64_t price;
+};
+
+template <typename Clock>
+class Strategy {
+ public:
+  explicit Strategy(Clock& clock)
+    : clock_(clock)
+    , ids_(clock, 1) {}
+
+  void onEvent(const Event& ev) {
+    int64_t now = clock_.rdns();
+    // throttle: at most one order per 50 us
+    if (ev.price > last_price_ + 2 && now - last_order_ns_ >= 50'000) {
+      uint64_t id = ids_.next();
+      digest_ = (digest_ ^ id ^ (uint64_t)now) * 0x100000001b3ULL;
+      last_order_ns_ = now;
+      orders_++;
+    }
+    last_price_ = ev.price;
+  }
+
+  uint64_t digest() const { return digest_; }
+  int64_t orders() const { return orders_; }
+
+ private:
+  Clock& clock_;
+  tscns::IdGen<Clock> ids_;
+  int64_t last_price_ = 0;
+  int64_t last_order_ns_ = 0;
+  int64_t orders_ = 0;
+  uint64_t digest_ = 0xcbf29ce484222325ULL;
+};
+
+static vector<Event> makeEvents(int n) {
+  vector<Event> events(n);
+  uint64_t x = 88172645463325252ULL;
+  int64_t ns = 1'700'000'000'000'000'000LL, price = 10000;
+  for (auto& ev : events) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    ns += 1000 + x % 20000;
+    price += (int64_t)(x >> 32) % 7 - 3;
+    ev = {ns, price};
+  }
+  return events;
+}
+
+// returns the number of events where rdns() didn't read exactly the event time, with ReplayClock at scale 1
+template <bool kReplay>
+static int64_t run(const vector<Event>& events, double scale) {
+  using Clock = tscns::ClockPolicy<kReplay>;
+  Clock clock;
+  clock.init();
+  if constexpr (kReplay) tscns::ReplayClock::rebase(events[0].ns, events[0].ns, scale);
+  Strategy<Clock> strategy(clock);
+  tscns::TSCNS<> wall;
+  wall.init(1'000'000);
+  int64_t off = 0;
+  int64_t t0 = wall.rdns();
+  for (auto& ev : events) {
+    if constexpr (kReplay) {
+      tscns::ReplayClock::setTime(ev.ns);
+      if (scale == 1.0) off += clock.rdns() != ev.ns;
+    }
+    strategy.onEvent(ev);
+  }
+  int64_t t1 = wall.rdns();
+  cout << (kReplay ? "replay" : "tscns ") << " scale " << std::setprecision(1) << fixed << scale
+       << ": orders: " << strategy.orders() << ", digest: " << hex << strategy.digest() << dec
+       << ", ns/event: " << std::setprecision(3) << (double)(t1 - t0) / events.size();
+  if (kReplay && scale == 1.0) cout << ", timestamps off: " << off;
+  cout << endl;
+  return off;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_replay_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int n = argc > 1 ? stoi(argv[1]) : 10'000'000;
+  auto events = makeEvents(n);
+  int64_t off = run<true>(events, 1.0);
+  off += run<true>(events, 1.0);
+  run<true>(events, 0.5);
+  run<false>(events, 1.0);
+  run<false>(events, 1.0);
+  return off ? 1 : 0;
+}
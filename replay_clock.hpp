@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <type_traits>
+#include "tscns.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Deterministic stand-in for TSCNS in backtests: same interface, but time only moves when the replay engine
+ * says so, from the timestamps of the recorded events (setTime()), optionally scaled, plus an optional fixed step on
+ * every read so busy-wait loops still terminate.
+ * The replay time is process wide, like the tsc register: rdtsc() is static in TSCNS and components call
+ * Clock::rdtsc(). It's a compile-time policy: code templated on its clock (HLC, IdGen, Watchdog...) or written
+ * against ClockPolicy<kReplay> gets either class, so the production build doesn't pay for the replay one.
+ *
+ * The virtual tsc counts from the first time set (setTime() or rebase()) and ticks at setTscGhz(): 1 by default, so
+ * conversions are exact integer arithmetic and rdns() returns exactly the time set; at other rates they're within 1 ns.
+ * init(), calibrate() and the other calibration calls are no-ops.
+ */
+class ReplayClock
+{
+public:
+    void init(int64_t = 20'000'000, int64_t = 3 * NsPerSec) {}
+    void calibrate() {}
+    int32_t calibrateStep(int64_t = 1'000) { return 0; }
+    void setCalibHook(CalibHook, void *) {}
+    static int64_t rdtsc();
+    int64_t tsc2ns(int64_t tsc) const { return toNs(tsc); }
+    int64_t rdns() const { return tsc2ns(rdtsc()); }
+    TimeInterval tsc2nsBounded(int64_t tsc) const { return TimeInterval {tsc2ns(tsc), tsc2ns(tsc)}; }
+    TimeInterval rdnsBounded() const { return tsc2nsBounded(rdtsc()); }
+    static int64_t rdsysns() { return toNs(rdtsc()); }
+    double getTscGhz() const { return tsc_ghz_; }
+    TscParam getParam() const { return TscParam {0, base_ns_, 1.0 / tsc_ghz_}; }
+
+    static void setTime(int64_t event_ns);
+    static void advance(int64_t delta_ns);
+    static void rebase(int64_t event_ns, int64_t clock_ns, double scale = 1.0);
+    static void setStep(int64_t step_ns) { step_tsc_ = toTsc(step_ns); }
+    static void setTscGhz(double ghz) { tsc_ghz_ = ghz; }
+
+    static constexpr int64_t NsPerSec = 1'000'000'000;
+
+private:
+    static int64_t toNs(int64_t tsc) { return base_ns_ + (tsc_ghz_ == 1.0 ? tsc : static_cast<int64_t>(tsc / tsc_ghz_)); }
+    static int64_t toTsc(int64_t delta_ns)
+    {
+        return tsc_ghz_ == 1.0 ? delta_ns : static_cast<int64_t>(delta_ns * tsc_ghz_);
+    }
+    // through double only at other rates than 1, and on ns relative to base_ns_: absolute epoch ns don't fit the 53
+    // bits of a double exactly
+
+    inline static std::atomic<int64_t> tsc_ {0};
+    inline static int64_t step_tsc_ = 0;
+    inline static double tsc_ghz_ = 1.0;
+    inline static int64_t event_origin_ = 0;
+    inline static int64_t clock_origin_ = 0;
+    inline static double scale_ = 1.0;
+    inline static int64_t base_ns_ = 0;
+    inline static bool based_ = false;
+    // ns at tsc 0, set by the first setTime()
+    // only the replay engine writes these, between events; strategy threads only read tsc_
+};
+
+// TSCNS<> in production, ReplayClock in the backtest build
+template <bool kReplay>
+using ClockPolicy = typename std::conditional<kReplay, ReplayClock, TSCNS<>>::type;
+
+inline int64_t ReplayClock::rdtsc()
+{
+    if(step_tsc_ == 0)
+    {
+        return tsc_.load(std::memory_order_relaxed);
+    }
+    return tsc_.fetch_add(step_tsc_, std::memory_order_relaxed) + step_tsc_;
+}
+
+// Move the clock to the time of the next event. Event time ns map to clock ns through the last rebase(): the clock
+// reads clock_ns at event_ns, and from there scale ns pass on the clock for every recorded ns.
+inline void ReplayClock::setTime(int64_t event_ns)
+{
+    int64_t elapsed_ns = event_ns - event_origin_;
+    int64_t ns = clock_origin_ + (scale_ == 1.0 ? elapsed_ns : static_cast<int64_t>(elapsed_ns * scale_));
+    if(!based_)
+    {
+        base_ns_ = ns;
+        based_ = true;
+    }
+    tsc_.store(toTsc(ns - base_ns_), std::memory_order_relaxed);
+}
+
+inline void ReplayClock::advance(int64_t delta_ns)
+{
+    tsc_.fetch_add(toTsc(delta_ns), std::memory_order_relaxed);
+}
+
+inline void ReplayClock::rebase(int64_t event_ns, int64_t clock_ns, double scale)
+{
+    event_origin_ = event_ns;
+    clock_origin_ = clock_ns;
+    scale_ = scale;
+    setTime(event_ns);
+}
+
+}
@@ -0,0 +1,281 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
+
+#ifdef _MSC_VER
+
+#define TSCNS_FORCE_INLINE __forceinline
+#define TSCNS_NOINLINE __declspec(noinline)
+
+#else //  _MSC_VER
+
+#if (defined(__GNUC__) && (__GNUC__ >= 4)) \
+    || (defined(__clang__) && (__clang_major__ >= 4)) \
+    || defined(__INTEL_COMPILER) \
+    || defined(__xlC__)
+
+#define TSCNS_FORCE_INLINE   __attribute__((always_inline)) inline
+#define TSCNS_NOINLINE       __attribute__((noinline))
+
+#else
+
+#define TSCNS_FORCE_INLINE
+#define TSCNS_NOINLINE
+
+#endif
+#endif
+
+// TSCNS_SEQLOCK_TSAN: the variant ThreadSanitizer understands, with no standalone fence. On by default under TSAN.
+#ifndef TSCNS_SEQLOCK_TSAN
+#if defined(__SANITIZE_THREAD__)
+#define TSCNS_SEQLOCK_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define TSCNS_SEQLOCK_TSAN 1
+#endif
+#endif
+#endif
+#ifndef TSCNS_SEQLOCK_TSAN
+#define TSCNS_SEQLOCK_TSAN 0
+#endif
+
+// TSCNS_SEQLOCK_ATOMIC: access the protected data with relaxed atomic loads and stores instead of plain ones, so the
+// protocol is race free by the C++ memory model itself instead of relying on the hardware ordering plain accesses
+// around the fences, and TSAN has nothing to report. They're plain mov/ldr/str all the same, but for GCC moving a
+// relaxed double through a general purpose register on x86 (movq mem, %r; movq %r, %xmm): there, outside of TSAN, a
+// double is loaded with a single movsd in inline asm instead, which is as atomic, so the code is the same as with plain
+// loads. On by default wherever relaxed atomics on plain objects are available.
+#ifndef TSCNS_SEQLOCK_ATOMIC
+#if TSCNS_SEQLOCK_TSAN || defined(__GNUC__) || defined(__clang__) || defined(__cpp_lib_atomic_ref)
+#define TSCNS_SEQLOCK_ATOMIC 1
+#else
+#define TSCNS_SEQLOCK_ATOMIC 0
+#endif
+#endif
+
+namespace tscns {
+
+// Default retry hook of SeqLock: a read that had to start over because of a concurrent write costs nothing more
+struct NoRetryHook
+{
+    void operator()() const {}
+};
+
+namespace seqlock_detail {
+
+template <typename M>
+M loadField(const M & field)
+{
+#if TSCNS_SEQLOCK_ATOMIC && !TSCNS_SEQLOCK_TSAN && defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+    if constexpr(std::is_same<M, double>::value)
+    {
+        double value;
+        asm("movsd %1, %0" : "=x"(value) : "m"(field));
+        return value;
+    }
+#endif
+#if TSCNS_SEQLOCK_ATOMIC && defined(__cpp_lib_atomic_ref)
+    return std::atomic_ref<M>(const_cast<M &>(field)).load(std::memory_order_relaxed);
+#elif TSCNS_SEQLOCK_ATOMIC
+    M value;
+    __atomic_load(&field, &value, __ATOMIC_RELAXED);
+    return value;
+#else
+    return field;
+#endif
+}
+
+template <typename M>
+void storeField(M & field, M value)
+{
+#if TSCNS_SEQLOCK_ATOMIC && defined(__cpp_lib_atomic_ref)
+    std::atomic_ref<M>(field).store(value, TSCNS_SEQLOCK_TSAN ? std::memory_order_release : std::memory_order_relaxed);
+#elif TSCNS_SEQLOCK_TSAN
+    __atomic_store(&field, &value, __ATOMIC_RELEASE);
+    // no fence for TSAN: release keeps the data stores after the odd sequence store instead
+#elif TSCNS_SEQLOCK_ATOMIC
+    __atomic_store(&field, &value, __ATOMIC_RELAXED);
+#else
+    field = value;
+#endif
+}
+
+#if TSCNS_SEQLOCK_ATOMIC
+#if defined(__GNUC__) || defined(__clang__)
+typedef uint64_t __attribute__((__may_alias__)) Word64;
+typedef uint32_t __attribute__((__may_alias__)) Word32;
+// words the data of any T can be copied through without breaking strict aliasing
+#else
+typedef uint64_t Word64;
+typedef uint32_t Word32;
+// MSVC doesn't optimize on strict aliasing
+#endif
+
+#define TSCNS_SEQLOCK_COPY_WORDS(Word)                                                                                 \
+    for(size_t i = 0; i < sizeof(T) / sizeof(Word); i++)                                                               \
+    {                                                                                                                  \
+        Word * d = reinterpret_cast<Word *>(&dst) + i;                                                                 \
+        const Word * s = reinterpret_cast<const Word *>(&src) + i;                                                     \
+        if(store)                                                                                                      \
+        {                                                                                                              \
+            storeField(*d, *s);                                                                                        \
+        }                                                                                                              \
+        else                                                                                                           \
+        {                                                                                                              \
+            *d = loadField(*s);                                                                                        \
+        }                                                                                                              \
+    }
+#endif
+
+// Copy of a T, word by word if atomic: a T may be too large to be loaded or stored atomically as a whole
+template <typename T>
+void copyData(T & dst, const T & src, bool store)
+{
+#if TSCNS_SEQLOCK_ATOMIC
+    if constexpr(sizeof(T) % 8 == 0 && alignof(T) >= 8)
+    {
+        TSCNS_SEQLOCK_COPY_WORDS(Word64)
+    }
+    else if constexpr(sizeof(T) % 4 == 0 && alignof(T) >= 4)
+    {
+        TSCNS_SEQLOCK_COPY_WORDS(Word32)
+    }
+    else
+    {
+        TSCNS_SEQLOCK_COPY_WORDS(unsigned char)
+    }
+#else
+    (void)store;
+    dst = src;
+    // an assignment rather than memcpy(), which GCC expands inline without TSAN instrumentation
+#endif
+}
+
+} // namespace seqlock_detail
+
+/**
+ * @brief Single writer, multiple readers seqlock around a trivially copyable T: readers never block the writer nor
+ * each other, they start over when a write happened in the middle of their read.
+ * The writer makes the sequence odd, writes, then makes it even again; a reader reads the sequence, the data, then the
+ * sequence again and retries if it was odd or has changed. The fences are those of the C++ memory model for seqlocks
+ * (acquire fence before the second sequence load, release fence after the first sequence store): free on x86.
+ * On aarch64 a read is ldar (ldapr with +rcpc), the ldr of the fields f uses, dmb ishld, ldr; a write is str, dmb ish,
+ * the str of the data, stlr.
+ *
+ * read(f) calls f with a view of the data, view(&T::field) reading one field, so only the fields f needs are loaded;
+ * f can run several times and must have no side effect. RetryHook()() is called on every retry, e.g. to count them.
+ * With kCachelineSize > 0 the lock is aligned and padded to whole cachelines; with 0 it's laid out as is, for
+ * embedding in a larger aligned structure.
+ */
+template <typename T, int32_t kCachelineSize = 64, typename RetryHook = NoRetryHook>
+class SeqLock
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock data must be trivially copyable");
+
+    class View
+    {
+    public:
+        template <typename M>
+        M operator()(M T::*field) const
+        {
+            return seqlock_detail::loadField(data_.*field);
+        }
+
+    private:
+        friend class SeqLock;
+        explicit View(const T & data)
+            : data_(data)
+        {
+        }
+        const T & data_;
+    };
+
+    template <typename F>
+    auto read(F && f) const -> decltype(f(std::declval<View>()));
+    T load() const;
+    void store(const T & value);
+
+    // the writer's own view of the data, no synchronization needed as nobody else writes it
+    const T & writerData() const { return data_; }
+    uint32_t sequence() const { return seq_.load(std::memory_order_relaxed); }
+
+private:
+    alignas(kCachelineSize > 0 ? kCachelineSize : alignof(std::atomic<uint32_t>)) mutable std::atomic<uint32_t> seq_ {0};
+    // mutable for the read-modify-write of readers in TSCNS_SEQLOCK_TSAN mode
+    T data_ {};
+};
+
+template <typename T, int32_t kCachelineSize, typename RetryHook>
+template <typename F>
+auto TSCNS_FORCE_INLINE SeqLock<T, kCachelineSize, RetryHook>::read(F && f) const -> decltype(f(std::declval<View>()))
+{
+    while(true)
+    {
+        uint32_t before_seq = seq_.load(std::memory_order_acquire) & ~1;
+        // clearing the lowest bit makes an odd sequence (write in progress) fail the check below
+        auto result = f(View(data_));
+#if TSCNS_SEQLOCK_TSAN
+        uint32_t after_seq = seq_.fetch_add(0, std::memory_order_release);
+        // no fence for TSAN: a read-modify-write stays after the data loads instead
+#else
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after_seq = seq_.load(std::memory_order_relaxed);
+#endif
+        if(before_seq == after_seq)
+        {
+            return result;
+        }
+        RetryHook()();
+    }
+}
+
+template <typename T, int32_t kCachelineSize, typename RetryHook>
+T SeqLock<T, kCachelineSize, RetryHook>::load() const
+{
+    return read([](const View & view) {
+        T value;
+        seqlock_detail::copyData(value, view.data_, false);
+        return value;
+    });
+}
+
+template <typename T, int32_t kCachelineSize, typename RetryHook>
+void SeqLock<T, kCachelineSize, RetryHook>::store(const T & value)
+{
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+#if !TSCNS_SEQLOCK_TSAN
+    std::atomic_thread_fence(std::memory_order_release);
+#endif
+    seqlock_detail::copyData(data_, value, true);
+    seq_.store(seq + 2, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,142 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include "tscns.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: seqlock_bench [reader_threads] [reads_per_thread] [write_interval_ns]
+// One writer updates a top-of-book snapshot every write_interval_ns while readers load it as fast as they can. Every
+// snapshot is written consistent (all fields derived from one counter), so a torn read is detected; retries are
+// counted through the retry hook.
+
+struct TopOfBook {
+  int64_t seq;
+  int64_t bid_px;
+  int64_t ask_px;
+  int32_t bid_qty;
+  int32_t ask_qty;
+  int64_t ts;
+};
+
+static thread_local int64_t retries = 0;
+
+struct CountRetries {
+  void operator()() const { retries++; }
+};
+
+static TopOfBook make(int64_t k) { return {k, 10000 + k, 10001 + k, (int32_t)(k & 0xffff), (int32_t)(k >> 16), ~k}; }
+
+static bool consistent(const TopOfBook& b) {
+  TopOfBook e = make(b.seq);
+  return b.bid_px == e.bid_px && b.ask_px == e.ask_px && b.bid_qty == e.bid_qty && b.ask_qty == e.ask_qty &&
+         b.ts == e.ts;
+}
+
+static tscns::TSCNS<> tn;
+static tscns::SeqLock<TopOfBook, 64, CountRetries> book;
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_seqlock_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int nthreads = argc > 1 ? stoi(argv[1]) : 3;
+  const int64_t N = argc > 2 ? stoll(argv[2]) : 10'000'000;
+  int64_t write_interval_ns = argc > 3 ? stoll(argv[3]) : 1000;
+  tn.init();
+  book.store(make(0));
+
+  atomic<bool> running{true};
+  atomic<int> ready{0};
+  int64_t writes = 0, write_ns = 0;
+  thread writer([&]() {
+    ready++;
+    while (ready.load() <= nthreads)
+      ;
+    int64_t k = 1;
+    while (running.load(memory_order_relaxed)) {
+      int64_t next = tn.rdns() + write_interval_ns;
+      int64_t t0 = tn.rdtsc();
+      book.store(make(k++));
+      write_ns += tn.rdtsc() - t0;
+      writes++;
+      while (tn.rdns() < next && running.load(memory_order_relaxed)) this_thread::yield();
+    }
+  });
+
+  vector<thread> readers;
+  vector<double> read_ns(nthreads), field_ns(nthreads);
+  vector<int64_t> torn(nthreads), reader_retries(nthreads);
+  for (int t = 0; t < nthreads; t++) {
+    readers.emplace_back([&, t]() {
+      ready++;
+      while (ready.load() <= nthreads)
+        ;
+      int64_t last = 0, bad = 0;
+      int64_t t0 = tn.rdns();
+      for (int64_t i = 0; i < N; i++) {
+        TopOfBook b = book.load();
+        bad += !consistent(b) || b.seq < last;
+        last = b.seq;
+      }
+      int64_t t1 = tn.rdns();
+      // read two fields only, as tsc2ns() does
+      int64_t sum = 0;
+      for (int64_t i = 0; i < N; i++) {
+        sum += book.read([](const auto& v) { return v(&TopOfBook::ask_px) - v(&TopOfBook::bid_px); });
+      }
+      int64_t t2 = tn.rdns();
+      bad += sum != N;
+      read_ns[t] = (double)(t1 - t0) / N;
+      field_ns[t] = (double)(t2 - t1) / N;
+      torn[t] = bad;
+      reader_retries[t] = retries;
+    });
+  }
+  for (auto& r : readers) r.join();
+  running = false;
+  writer.join();
+
+  int64_t total_torn = 0, total_retries = 0;
+  double load_avg = 0, read_avg = 0;
+  for (int t = 0; t < nthreads; t++) {
+    total_torn += torn[t];
+    total_retries += reader_retries[t];
+    load_avg += read_ns[t] / nthreads;
+    read_avg += field_ns[t] / nthreads;
+  }
+  cout << std::setprecision(3) << fixed << "readers: " << nthreads << ", load ns: " << load_avg
+       << ", read(2 fields) ns: " << read_avg << ", retries per 1M reads: " << total_retries * 1e6 / (2.0 * N * nthreads)
+       << ", writes: " << writes << ", write ns: " << (writes ? write_ns / tn.getTscGhz() / writes : 0)
+       << ", torn reads: " << total_torn << endl;
+  return total_torn ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include "seqlock.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: seqlock_stress [seconds] [reader_threads] [broken]
+// Litmus style stress test of SeqLock: a writer stores blocks of 8 equal words as fast as it can while readers check
+// every block they read is whole (all words equal) and never older than the previous one. Run it on the target CPU,
+// e.g. aarch64, with one thread per core.
+// "broken" runs the same test against the protocol TSCNS used to have (plain accesses with compiler-only fences): on
+// a weakly ordered CPU it should find torn reads, showing the test can catch them.
+
+struct Block {
+  int64_t v[8];
+};
+
+// the old protocol, only here as a control
+class BrokenSeqLock {
+ public:
+  Block read() const {
+    Block b;
+    uint32_t before, after;
+    do {
+      before = seq_.load(memory_order_acquire) & ~1;
+      atomic_signal_fence(memory_order_acq_rel);
+      b = data_;
+      atomic_signal_fence(memory_order_acq_rel);
+      after = seq_.load(memory_order_acquire);
+    } while (before != after);
+    return b;
+  }
+  void store(const Block& b) {
+    uint32_t seq = seq_.load(memory_order_relaxed);
+    seq_.store(seq + 1, memory_order_release);
+    atomic_signal_fence(memory_order_acq_rel);
+    data_ = b;
+    atomic_signal_fence(memory_order_acq_rel);
+    seq_.store(seq + 2, memory_order_release);
+  }
+
+ private:
+  alignas(64) atomic<uint32_t> seq_{0};
+  Block data_{};
+};
+
+static thread_local int64_t retries = 0;
+
+struct CountRetries {
+  void operator()() const { retries++; }
+};
+
+class FixedSeqLock {
+ public:
+  Block read() const { return lock_.load(); }
+  void store(const Block& b) { lock_.store(b); }
+
+ private:
+  tscns::SeqLock<Block, 64, CountRetries> lock_;
+};
+
+template <typename Lock>
+static int run(int64_t seconds, int nthreads, const char* name) {
+  Lock lock;
+  atomic<bool> running{true};
+  vector<int64_t> reads(nthreads), torn(nthreads), backwards(nthreads), thread_retries(nthreads);
+  vector<thread> readers;
+  for (int t = 0; t < nthreads; t++) {
+    readers.emplace_back([&, t]() {
+      int64_t last = 0;
+      while (running.load(memory_order_relaxed)) {
+        for (int i = 0; i < 1024; i++) {
+          Block b = lock.read();
+          bool whole = true;
+          for (int j = 1; j < 8; j++) whole &= b.v[j] == b.v[0];
+          torn[t] += !whole;
+          backwards[t] += b.v[0] < last;
+          last = b.v[0];
+        }
+        reads[t] += 1024;
+      }
+      thread_retries[t] = retries;
+    });
+  }
+  int64_t writes = 0;
+  auto end = chrono::steady_clock::now() + chrono::seconds(seconds);
+  while (chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 1024; i++) {
+      Block b;
+      writes++;
+      for (int j = 0; j < 8; j++) b.v[j] = writes;
+      lock.store(b);
+    }
+  }
+  running = false;
+  int64_t total_reads = 0, total_torn = 0, total_backwards = 0, total_retries = 0;
+  for (int t = 0; t < nthreads; t++) {
+    readers[t].join();
+    total_reads += reads[t];
+    total_torn += torn[t];
+    total_backwards += backwards[t];
+    total_retries += thread_retries[t];
+  }
+  cout << name << ": writes: " << writes << ", reads: " << total_reads << ", retries: " << total_retries
+       << ", torn: " << total_torn << ", went backwards: " << total_backwards << endl;
+  return total_torn || total_backwards;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_seqlock_stress_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int64_t seconds = argc > 1 ? stoll(argv[1]) : 10;
+  int nthreads = argc > 2 ? stoi(argv[2]) : max(1, (int)thread::hardware_concurrency() - 1);
+  bool broken = argc > 3 && string(argv[3]) == "broken";
+  cout << "TSCNS_SEQLOCK_ATOMIC: " << TSCNS_SEQLOCK_ATOMIC << ", TSCNS_SEQLOCK_TSAN: " << TSCNS_SEQLOCK_TSAN
+       << ", reader threads: " << nthreads << endl;
+  if (broken) return run<BrokenSeqLock>(seconds, nthreads, "broken");
+  return run<FixedSeqLock>(seconds, nthreads, "seqlock");
+}
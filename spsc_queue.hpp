@@ -0,0 +1,147 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <array>
+
+namespace tscns {
+
+/**
+ * @brief Bounded lock-free single producer single consumer queue, kSize must be a power of 2.
+ * Write and read indexes are in separate cachelines, and each side caches the other's index so that it only touches
+ * the other side's cacheline when the queue looks full (or empty). Being free of pointers, it can also be placed in
+ * shared memory between processes if T is trivially copyable.
+ */
+template <typename T, uint32_t kSize, int32_t kCachelineSize = 64>
+class SpscQueue
+{
+public:
+    static_assert(kSize && (kSize & (kSize - 1)) == 0, "kSize must be a power of 2");
+
+    // producer: slot to construct the next element in, then push() it; nullptr if the queue is full
+    T * alloc();
+    void push();
+    bool tryPush(const T & value);
+
+    // consumer: the oldest element, then pop() it; nullptr if the queue is empty
+    T * front();
+    void pop();
+    bool empty() const;
+
+    // consumer, by batches: number of elements ready, the i-th oldest of them, then pop(n) them all at once
+    uint32_t readable();
+    T * peek(uint32_t i);
+    void pop(uint32_t n);
+
+private:
+    alignas(kCachelineSize) std::atomic<uint32_t> write_idx_ {0};
+    uint32_t cached_read_idx_ = 0;
+    alignas(kCachelineSize) std::atomic<uint32_t> read_idx_ {0};
+    uint32_t cached_write_idx_ = 0;
+    alignas(kCachelineSize) std::array<T, kSize> data_;
+};
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+T * SpscQueue<T, kSize, kCachelineSize>::alloc()
+{
+    uint32_t write_idx = write_idx_.load(std::memory_order_relaxed);
+    if(write_idx - cached_read_idx_ == kSize)
+    {
+        cached_read_idx_ = read_idx_.load(std::memory_order_acquire);
+        if(write_idx - cached_read_idx_ == kSize)
+        {
+            return nullptr;
+        }
+    }
+    return &data_[write_idx & (kSize - 1)];
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+void SpscQueue<T, kSize, kCachelineSize>::push()
+{
+    write_idx_.store(write_idx_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+bool SpscQueue<T, kSize, kCachelineSize>::tryPush(const T & value)
+{
+    T * slot = alloc();
+    if(!slot)
+    {
+        return false;
+    }
+    *slot = value;
+    push();
+    return true;
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+T * SpscQueue<T, kSize, kCachelineSize>::front()
+{
+    uint32_t read_idx = read_idx_.load(std::memory_order_relaxed);
+    if(read_idx == cached_write_idx_)
+    {
+        cached_write_idx_ = write_idx_.load(std::memory_order_acquire);
+        if(read_idx == cached_write_idx_)
+        {
+            return nullptr;
+        }
+    }
+    return &data_[read_idx & (kSize - 1)];
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+void SpscQueue<T, kSize, kCachelineSize>::pop()
+{
+    read_idx_.store(read_idx_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+bool SpscQueue<T, kSize, kCachelineSize>::empty() const
+{
+    return read_idx_.load(std::memory_order_acquire) == write_idx_.load(std::memory_order_acquire);
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+uint32_t SpscQueue<T, kSize, kCachelineSize>::readable()
+{
+    cached_write_idx_ = write_idx_.load(std::memory_order_acquire);
+    return cached_write_idx_ - read_idx_.load(std::memory_order_relaxed);
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+T * SpscQueue<T, kSize, kCachelineSize>::peek(uint32_t i)
+{
+    return &data_[(read_idx_.load(std::memory_order_relaxed) + i) & (kSize - 1)];
+}
+
+template <typename T, uint32_t kSize, int32_t kCachelineSize>
+void SpscQueue<T, kSize, kCachelineSize>::pop(uint32_t n)
+{
+    read_idx_.store(read_idx_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+}
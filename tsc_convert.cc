@@ -0,0 +1,212 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tsc_epochs.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: tsc_convert epochs_file capture_file record_size ts_offset [out_file] [threads]
+// Converts the raw tsc stamped in every fixed size record of a capture file to ns, using the calibration epochs the
+// application saved along the way (tscns::TscEpochs::save()). The int64 tsc at byte ts_offset of each record is
+// replaced by its ns, in place or into out_file (the rest of the record is copied as is).
+//
+// In place, the records are converted into capture_file.converting next to it, which is renamed over capture_file only
+// once every window is converted and synced: a conversion failing partway leaves the capture untouched instead of a
+// mix of tsc and ns records, at the cost of free disk space for a second copy while it runs.
+//
+// The file is processed in windows mapped one at a time by each thread, so files larger than RAM go at disk speed:
+// the kernel streams pages in ahead of us and writes dirty ones back behind us.
+
+static constexpr size_t WindowBytes = 64 << 20;
+static constexpr size_t BatchRecords = 4096;
+
+struct Window {
+  char* base;
+  char* data;
+  size_t map_len;
+};
+
+static bool mapWindow(int fd, size_t offset, size_t len, bool writable, Window& w) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t aligned = offset / page * page;
+  w.map_len = len + (offset - aligned);
+  void* p = mmap(nullptr, w.map_len, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, aligned);
+  if (p == MAP_FAILED) return false;
+  madvise(p, w.map_len, MADV_SEQUENTIAL);
+  w.base = (char*)p;
+  w.data = w.base + (offset - aligned);
+  return true;
+}
+
+// Gathers a batch of tsc, converts them with the batch path of TscEpochs and scatters the ns back
+static void convert(const tscns::TscEpochs& epochs, const char* in, char* out, size_t records, size_t record_size,
+                    size_t ts_offset) {
+  int64_t tsc[BatchRecords], ns[BatchRecords];
+  if (in != out) memcpy(out, in, records * record_size);
+  for (size_t i = 0; i < records; i += BatchRecords) {
+    size_t n = min(BatchRecords, records - i);
+    char* rec = out + i * record_size + ts_offset;
+    if (record_size == sizeof(int64_t)) {
+      // plain array of timestamps, convert it where it is
+      memcpy(tsc, rec, n * sizeof(int64_t));
+      epochs.tsc2nsBatch(tsc, ns, n);
+      memcpy(rec, ns, n * sizeof(int64_t));
+      continue;
+    }
+    for (size_t j = 0; j < n; j++) memcpy(&tsc[j], rec + j * record_size, sizeof(int64_t));
+    epochs.tsc2nsBatch(tsc, ns, n);
+    for (size_t j = 0; j < n; j++) memcpy(rec + j * record_size, &ns[j], sizeof(int64_t));
+  }
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_tsc_convert_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  if (argc < 5) {
+    cerr << "usage: " << argv[0] << " epochs_file capture_file record_size ts_offset [out_file] [threads]" << endl;
+    return 1;
+  }
+  tscns::TscEpochs epochs;
+  if (!epochs.load(argv[1]) || epochs.empty()) {
+    cerr << "failed to load epochs from " << argv[1] << endl;
+    return 1;
+  }
+  const char* in_path = argv[2];
+  size_t record_size = stoull(argv[3]);
+  size_t ts_offset = stoull(argv[4]);
+  const char* out_path = argc > 5 && strcmp(argv[5], "-") != 0 ? argv[5] : nullptr;
+  int nthreads = argc > 6 ? stoi(argv[6]) : (int)std::thread::hardware_concurrency();
+  if (record_size == 0 || ts_offset + sizeof(int64_t) > record_size) {
+    cerr << "the timestamp doesn't fit in the record" << endl;
+    return 1;
+  }
+
+  int in_fd = open(in_path, O_RDONLY);
+  struct stat st;
+  if (in_fd < 0 || fstat(in_fd, &st) != 0) {
+    cerr << "failed to open " << in_path << endl;
+    if (in_fd >= 0) close(in_fd);
+    return 1;
+  }
+  size_t records = st.st_size / record_size;
+  size_t tail = st.st_size % record_size;
+  bool in_place = !out_path;
+  string tmp_path = string(in_path) + ".converting";
+  if (in_place) out_path = tmp_path.c_str();
+  // in place the trailing bytes stay in the file, as they would if it were rewritten where it is
+  size_t out_size = records * record_size + (in_place ? tail : 0);
+  int out_fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, in_place ? (st.st_mode & 0777) : 0644);
+  if (out_fd < 0 || ftruncate(out_fd, out_size) != 0) {
+    cerr << "failed to create " << out_path << endl;
+    if (out_fd >= 0) {
+      close(out_fd);
+      if (in_place) unlink(out_path);
+    }
+    close(in_fd);
+    return 1;
+  }
+
+  size_t window_records = max(WindowBytes / record_size, size_t(1));
+  size_t windows = (records + window_records - 1) / window_records;
+  std::atomic<size_t> next_window{0};
+  std::atomic<bool> failed{false};
+  int64_t t0 = tscns::TSCNS<>::rdsysns();
+  vector<thread> thrs;
+  for (int t = 0; t < max(nthreads, 1); t++) {
+    thrs.emplace_back([&]() {
+      size_t w;
+      while ((w = next_window.fetch_add(1)) < windows) {
+        size_t first = w * window_records;
+        size_t n = min(window_records, records - first);
+        Window in, out;
+        if (!mapWindow(in_fd, first * record_size, n * record_size, false, in)) {
+          failed = true;
+          return;
+        }
+        if (!mapWindow(out_fd, first * record_size, n * record_size, true, out)) {
+          munmap(in.base, in.map_len);
+          failed = true;
+          return;
+        }
+        convert(epochs, in.data, out.data, n, record_size, ts_offset);
+        munmap(in.base, in.map_len);
+        munmap(out.base, out.map_len);
+      }
+    });
+  }
+  for (auto& thr : thrs) thr.join();
+  if (!failed && in_place && tail) {
+    char buf[4096]; // tail < record_size, which may be larger than a page
+    for (size_t off = records * record_size, end = off + tail; off < end && !failed;) {
+      ssize_t n = pread(in_fd, buf, min(sizeof(buf), end - off), off);
+      if (n <= 0 || pwrite(out_fd, buf, n, off) != n) failed = true;
+      off += n > 0 ? n : 0;
+    }
+  }
+  // the converted copy must be on disk before it replaces the capture
+  bool synced = !failed && (!in_place || fsync(out_fd) == 0);
+  int64_t t1 = tscns::TSCNS<>::rdsysns();
+  close(out_fd);
+  close(in_fd);
+  if (failed || !synced) {
+    cerr << "failed to " << (failed ? "convert " : "sync ") << in_path << " into " << out_path << endl;
+    if (in_place) {
+      unlink(out_path);
+      cerr << in_path << " is left unconverted" << endl;
+    }
+    return 1;
+  }
+  if (in_place && rename(out_path, in_path) != 0) {
+    cerr << "failed to rename " << out_path << " over " << in_path << ", " << in_path << " is left unconverted"
+         << endl;
+    unlink(out_path);
+    return 1;
+  }
+
+  double secs = max(t1 - t0, int64_t(1)) / 1e9;
+  cout << std::setprecision(3) << fixed << "records: " << records << ", epochs: " << epochs.size()
+       << ", threads: " << nthreads << ", seconds: " << secs << ", MB/s: " << records * record_size / 1e6 / secs
+       << endl;
+  if (tail) {
+    cerr << "warning: " << tail << " trailing bytes " << (in_place ? "left as is" : "ignored") << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "tscns.hpp"
+
+namespace tscns {
+
+/**
+ * @brief History of calibration parameters, to convert tsc recorded at any time with the parameters that were in use
+ * back then rather than the current ones.
+ * Epochs are kept in increasing order of base_tsc; a tsc is converted with the last epoch starting at or before it
+ * (the first one for older tsc). An empty history has nothing to convert with: every tsc converts to 0, and find()
+ * returns 0, which isn't an index then.
+ */
+class TscEpochs
+{
+public:
+    template <typename Clock>
+    void add(const Clock & clock) { add(clock.getParam()); }
+    void add(const TscParam & param);
+    bool empty() const { return epochs_.empty(); }
+    size_t size() const { return epochs_.size(); }
+    const TscParam & operator[](size_t i) const { return epochs_[i]; }
+    size_t find(int64_t tsc) const;
+    int64_t tsc2ns(int64_t tsc) const { return epochs_.empty() ? 0 : epochs_[find(tsc)].tsc2ns(tsc); }
+    void tsc2nsBatch(const int64_t * tsc, int64_t * ns, size_t n) const;
+    bool save(const char * path) const;
+    bool load(const char * path);
+
+    /**
+     * @brief Converts increasing tsc without searching, by moving forward through the epochs.
+     * One per thread, for converting a sorted stream such as the output of a merge.
+     */
+    class Cursor
+    {
+    public:
+        explicit Cursor(const TscEpochs & epochs, size_t start = 0)
+            : epochs_(epochs.epochs_)
+            , idx_(start)
+        {
+        }
+        int64_t tsc2ns(int64_t tsc);
+
+    private:
+        const std::vector<TscParam> & epochs_;
+        size_t idx_;
+    };
+
+    static constexpr uint64_t FileMagic = 0x315348434f504554;
+    // "TEPOCHS1" in little endian
+
+private:
+    std::vector<TscParam> epochs_;
+};
+
+// Adding a snapshot that's identical to the last one is a no-op, so snapshots can be taken blindly
+inline void TscEpochs::add(const TscParam & param)
+{
+    if(!epochs_.empty() && epochs_.back().base_tsc >= param.base_tsc)
+    {
+        return;
+    }
+    epochs_.push_back(param);
+}
+
+inline size_t TscEpochs::find(int64_t tsc) const
+{
+    auto it = std::upper_bound(epochs_.begin(), epochs_.end(), tsc,
+                               [](int64_t t, const TscParam & param) { return t < param.base_tsc; });
+    return it == epochs_.begin() ? 0 : it - epochs_.begin() - 1;
+}
+
+// Converts n tsc at once. Runs within one epoch are converted by a plain loop the compiler can vectorize.
+inline void TscEpochs::tsc2nsBatch(const int64_t * tsc, int64_t * ns, size_t n) const
+{
+    if(epochs_.empty())
+    {
+        std::fill(ns, ns + n, 0);
+        return;
+    }
+    size_t i = 0;
+    while(i < n)
+    {
+        size_t e = find(tsc[i]);
+        int64_t lo = e == 0 ? std::numeric_limits<int64_t>::min() : epochs_[e].base_tsc;
+        int64_t hi = e + 1 == epochs_.size() ? std::numeric_limits<int64_t>::max() : epochs_[e + 1].base_tsc;
+        size_t end = i + 1;
+        while(end < n && tsc[end] >= lo && tsc[end] < hi)
+        {
+            end++;
+        }
+        const int64_t base_tsc = epochs_[e].base_tsc, base_ns = epochs_[e].base_ns;
+        const double ns_per_tsc = epochs_[e].ns_per_tsc;
+        for(size_t j = i; j < end; j++)
+        {
+            ns[j] = base_ns + static_cast<int64_t>((tsc[j] - base_tsc) * ns_per_tsc);
+        }
+        i = end;
+    }
+}
+
+inline int64_t TscEpochs::Cursor::tsc2ns(int64_t tsc)
+{
+    if(epochs_.empty())
+    {
+        return 0;
+    }
+    while(idx_ + 1 < epochs_.size() && epochs_[idx_ + 1].base_tsc <= tsc)
+    {
+        idx_++;
+    }
+    return epochs_[idx_].tsc2ns(tsc);
+}
+
+// File format: FileMagic, epoch count, then the TscParam structs, all in native byte order
+inline bool TscEpochs::save(const char * path) const
+{
+    FILE * f = fopen(path, "wb");
+    if(!f)
+    {
+        return false;
+    }
+    uint64_t header[2] = {FileMagic, epochs_.size()};
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+              fwrite(epochs_.data(), sizeof(TscParam), epochs_.size(), f) == epochs_.size();
+    return fclose(f) == 0 && ok;
+}
+
+// The epochs are left untouched if the file is missing, isn't an epochs file, or its count doesn't match its size
+inline bool TscEpochs::load(const char * path)
+{
+    FILE * f = fopen(path, "rb");
+    if(!f)
+    {
+        return false;
+    }
+    uint64_t header[2];
+    bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == FileMagic;
+    long end = -1;
+    if(ok && fseek(f, 0, SEEK_END) == 0)
+    {
+        end = ftell(f);
+    }
+    // the count comes from the file: check it against what the file holds before allocating for it
+    ok = ok && end >= static_cast<long>(sizeof(header)) &&
+         header[1] == (end - sizeof(header)) / sizeof(TscParam) &&
+         (end - sizeof(header)) % sizeof(TscParam) == 0 && fseek(f, sizeof(header), SEEK_SET) == 0;
+    std::vector<TscParam> epochs;
+    if(ok)
+    {
+        epochs.resize(header[1]);
+        ok = fread(epochs.data(), sizeof(TscParam), epochs.size(), f) == epochs.size();
+    }
+    fclose(f);
+    if(ok)
+    {
+        epochs_.swap(epochs);
+    }
+    return ok;
+}
+
+}
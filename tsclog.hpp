@@ -0,0 +1,440 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include "tscns.hpp"
+
+/**
+ * NanoLog style deferred logger: the hot thread only records the raw tsc, the id of the (static) format string and the
+ * raw bytes of the arguments into a buffer of its own, a backend thread drains all buffers into a compact binary file,
+ * and tsclog_decompress renders it as text with ns timestamps, offline.
+ *
+ * Usage:
+ *   tscns::TscLog::instance().start("app.tlog", tn);
+ *   TSCLOG("order %d filled at %.2f, venue %s", order_id, price, venue);
+ *   ...
+ *   tscns::TscLog::instance().stop();
+ *
+ * Arguments can be integers, floating point numbers and C strings (copied). A log call never blocks: if the thread's
+ * buffer is full the message is dropped and counted.
+ */
+#define TSCLOG(fmt, ...)                                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static const uint32_t tsclog_fmt_id =                                                                          \
+            ::tscns::TscLog::registerFormat(fmt, __FILE__, __LINE__, ::tscns::tsclog_detail::typeCodes(__VA_ARGS__));  \
+        ::tscns::TscLog::log(tsclog_fmt_id, ##__VA_ARGS__);                                                            \
+    } while(0)
+
+namespace tscns {
+
+namespace tsclog_detail {
+
+// One char per argument in the file: i(nt64), u(int64), d(ouble), s(tring)
+template <typename T>
+constexpr char typeCode()
+{
+    using U = std::decay_t<T>;
+    if constexpr(std::is_same_v<U, const char *> || std::is_same_v<U, char *>)
+    {
+        return 's';
+    }
+    else if constexpr(std::is_floating_point_v<U>)
+    {
+        return 'd';
+    }
+    else if constexpr(std::is_integral_v<U> && std::is_signed_v<U>)
+    {
+        return 'i';
+    }
+    else
+    {
+        static_assert(std::is_integral_v<U> || std::is_enum_v<U>, "unsupported TSCLOG argument type");
+        return 'u';
+    }
+}
+
+template <typename... Args>
+std::string typeCodes(const Args &...)
+{
+    return std::string {typeCode<Args>()...};
+}
+
+template <typename T>
+size_t argSize(const T & arg)
+{
+    if constexpr(typeCode<T>() == 's')
+    {
+        return sizeof(uint32_t) + strlen(arg);
+    }
+    else
+    {
+        return sizeof(int64_t);
+    }
+}
+
+template <typename T>
+void writeArg(char *& p, const T & arg)
+{
+    constexpr char code = typeCode<T>();
+    if constexpr(code == 's')
+    {
+        uint32_t len = static_cast<uint32_t>(strlen(arg));
+        memcpy(p, &len, sizeof(len));
+        memcpy(p + sizeof(len), arg, len);
+        p += sizeof(len) + len;
+    }
+    else
+    {
+        using V = std::conditional_t<code == 'd', double, std::conditional_t<code == 'i', int64_t, uint64_t>>;
+        V v = static_cast<V>(arg);
+        memcpy(p, &v, sizeof(v));
+        p += sizeof(v);
+    }
+}
+
+} // namespace tsclog_detail
+
+/**
+ * @brief The logger: per-thread buffers and the backend thread draining them.
+ * File format: FileMagic, then entries each starting with a kind byte, all in native byte order:
+ *   'F' format: id, line, file, argument type codes, format string (strings as uint32 length + chars)
+ *   'E' epoch: TscParam in use from then on, written whenever the clock is calibrated
+ *   'L' log: format id, tsc, uint32 size of the arguments, arguments as typed in the format entry
+ * Entries of different threads are interleaved in the order they're drained, not in tsc order.
+ */
+class TscLog
+{
+public:
+    static constexpr uint64_t FileMagic = 0x31304f474c435354;
+    // "TSCLOG01" in little endian
+    static constexpr uint32_t BufferSize = 1 << 20;
+    // per thread, power of 2
+
+    ~TscLog() { stop(); }
+    static TscLog & instance();
+    static uint32_t registerFormat(const char * fmt, const char * file, uint32_t line, const std::string & types);
+    template <typename... Args>
+    static void log(uint32_t fmt_id, const Args &... args);
+    static void preallocate() { threadBuffer(); }
+    // set up the calling thread's buffer now, so its first log doesn't pay for it
+
+    template <typename Clock>
+    bool start(const char * path, const Clock & clock, int64_t poll_interval_ns = 1'000'000);
+    void stop();
+    int64_t droppedLogs() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    // Record in a thread buffer: header, then the arguments; sizes are rounded up to RecordAlign so a record never
+    // wraps around the end of the buffer, it's preceded by a padding record instead.
+    struct RecordHeader
+    {
+        uint32_t fmt_id;
+        uint32_t size;
+        int64_t tsc;
+    };
+    static constexpr uint32_t RecordAlign = sizeof(RecordHeader);
+    static constexpr uint32_t PaddingId = 0xffffffff;
+
+    struct ThreadBuffer
+    {
+        alignas(64) std::atomic<uint64_t> write_pos {0};
+        uint64_t cached_read_pos = 0;
+        alignas(64) std::atomic<uint64_t> read_pos {0};
+        std::atomic<bool> retired {false};
+        alignas(64) char data[BufferSize];
+
+        ThreadBuffer() { memset(data, 0, sizeof(data)); }
+        // touch every page now rather than page faulting on the hot path later
+        char * alloc(uint32_t size);
+    };
+
+    struct ThreadBufferHolder
+    {
+        ThreadBuffer * buffer = nullptr;
+        ~ThreadBufferHolder();
+    };
+
+    struct Format
+    {
+        std::string fmt;
+        std::string file;
+        uint32_t line;
+        std::string types;
+    };
+
+    static ThreadBuffer * threadBuffer();
+    bool startBackend(const char * path, std::function<TscParam()> get_param, int64_t poll_interval_ns);
+    void backend(int64_t poll_interval_ns);
+    bool drain();
+    void writeFormats();
+    void writeEpoch();
+    template <typename T>
+    void put(const T & v) { out_.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+    void flush();
+
+    std::mutex mutex_;
+    // protects formats_ and buffers_
+    std::vector<Format> formats_;
+    std::vector<ThreadBuffer *> buffers_;
+    std::atomic<int64_t> dropped_ {0};
+
+    // backend thread only
+    FILE * file_ = nullptr;
+    std::string out_;
+    size_t formats_written_ = 0;
+    TscParam last_param_ {};
+    std::function<TscParam()> get_param_;
+    std::atomic<bool> running_ {false};
+    std::thread thread_;
+};
+
+inline TscLog & TscLog::instance()
+{
+    static TscLog log;
+    return log;
+}
+
+inline uint32_t TscLog::registerFormat(const char * fmt, const char * file, uint32_t line, const std::string & types)
+{
+    TscLog & self = instance();
+    std::lock_guard<std::mutex> lock(self.mutex_);
+    self.formats_.push_back({fmt, file, line, types});
+    return static_cast<uint32_t>(self.formats_.size() - 1);
+}
+
+// Reserve size bytes for a record, nullptr if the buffer is full
+inline char * TscLog::ThreadBuffer::alloc(uint32_t size)
+{
+    uint64_t pos = write_pos.load(std::memory_order_relaxed);
+    uint32_t tail = BufferSize - static_cast<uint32_t>(pos & (BufferSize - 1));
+    uint32_t need = tail < size ? tail + size : size;
+    if(pos + need - cached_read_pos > BufferSize)
+    {
+        cached_read_pos = read_pos.load(std::memory_order_acquire);
+        if(pos + need - cached_read_pos > BufferSize)
+        {
+            return nullptr;
+        }
+    }
+    if(tail < size)
+    {
+        // not enough room before the end, pad it and start over from the beginning
+        RecordHeader pad {PaddingId, tail, 0};
+        memcpy(data + (pos & (BufferSize - 1)), &pad, sizeof(pad));
+        pos += tail;
+        write_pos.store(pos, std::memory_order_release);
+    }
+    return data + (pos & (BufferSize - 1));
+}
+
+inline TscLog::ThreadBufferHolder::~ThreadBufferHolder()
+{
+    if(buffer)
+    {
+        // the backend frees it once drained
+        buffer->retired.store(true, std::memory_order_release);
+    }
+}
+
+inline TscLog::ThreadBuffer * TscLog::threadBuffer()
+{
+    static thread_local ThreadBufferHolder holder;
+    if(!holder.buffer)
+    {
+        holder.buffer = new ThreadBuffer;
+        TscLog & self = instance();
+        std::lock_guard<std::mutex> lock(self.mutex_);
+        self.buffers_.push_back(holder.buffer);
+    }
+    return holder.buffer;
+}
+
+template <typename... Args>
+void TscLog::log(uint32_t fmt_id, const Args &... args)
+{
+    int64_t tsc = TSCNS<>::rdtsc();
+    ThreadBuffer * buffer = threadBuffer();
+    size_t args_size = (size_t(0) + ... + tsclog_detail::argSize(args));
+    uint32_t size = static_cast<uint32_t>((sizeof(RecordHeader) + args_size + RecordAlign - 1) & ~size_t(RecordAlign - 1));
+    char * p = size <= BufferSize / 2 ? buffer->alloc(size) : nullptr;
+    if(!p)
+    {
+        instance().dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    RecordHeader header {fmt_id, size, tsc};
+    memcpy(p, &header, sizeof(header));
+    [[maybe_unused]] char * args_p = p + sizeof(header);
+    (tsclog_detail::writeArg(args_p, args), ...);
+    buffer->write_pos.store(buffer->write_pos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+template <typename Clock>
+bool TscLog::start(const char * path, const Clock & clock, int64_t poll_interval_ns)
+{
+    return startBackend(path, [&clock]() { return clock.getParam(); }, poll_interval_ns);
+}
+
+inline bool TscLog::startBackend(const char * path, std::function<TscParam()> get_param, int64_t poll_interval_ns)
+{
+    if(running_.load() || !(file_ = fopen(path, "wb")))
+    {
+        return false;
+    }
+    get_param_ = std::move(get_param);
+    formats_written_ = 0;
+    last_param_ = {};
+    out_.clear();
+    put(FileMagic);
+    running_.store(true);
+    thread_ = std::thread(&TscLog::backend, this, poll_interval_ns);
+    return true;
+}
+
+// Drain everything logged so far and close the file
+inline void TscLog::stop()
+{
+    if(!running_.exchange(false))
+    {
+        return;
+    }
+    thread_.join();
+    fclose(file_);
+    file_ = nullptr;
+}
+
+inline void TscLog::backend(int64_t poll_interval_ns)
+{
+    while(true)
+    {
+        bool running = running_.load();
+        // check before draining: once stopped, the last drain still gets everything logged before stop()
+        writeEpoch();
+        bool busy = drain();
+        flush();
+        if(!running)
+        {
+            break;
+        }
+        if(!busy)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(poll_interval_ns));
+        }
+    }
+}
+
+inline bool TscLog::drain()
+{
+    std::vector<ThreadBuffer *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers = buffers_;
+    }
+    writeFormats();
+    // formats are registered before any record using them is written, so all the ones we'll meet are out now
+    bool busy = false;
+    for(ThreadBuffer * buffer : buffers)
+    {
+        bool retired = buffer->retired.load(std::memory_order_acquire);
+        uint64_t pos = buffer->read_pos.load(std::memory_order_relaxed);
+        uint64_t end = buffer->write_pos.load(std::memory_order_acquire);
+        busy |= pos != end;
+        while(pos != end)
+        {
+            RecordHeader header;
+            const char * p = buffer->data + (pos & (BufferSize - 1));
+            memcpy(&header, p, sizeof(header));
+            if(header.fmt_id != PaddingId)
+            {
+                uint32_t args_size = header.size - static_cast<uint32_t>(sizeof(header));
+                out_.push_back('L');
+                put(header.fmt_id);
+                put(header.tsc);
+                put(args_size);
+                out_.append(p + sizeof(header), args_size);
+            }
+            pos += header.size;
+        }
+        buffer->read_pos.store(pos, std::memory_order_release);
+        if(retired)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.erase(std::find(buffers_.begin(), buffers_.end(), buffer));
+            delete buffer;
+        }
+    }
+    return busy;
+}
+
+// 'F' entries for the formats not written yet
+inline void TscLog::writeFormats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(; formats_written_ < formats_.size(); formats_written_++)
+    {
+        const Format & format = formats_[formats_written_];
+        out_.push_back('F');
+        put(static_cast<uint32_t>(formats_written_));
+        put(format.line);
+        put(static_cast<uint32_t>(format.file.size()));
+        out_.append(format.file);
+        put(static_cast<uint32_t>(format.types.size()));
+        out_.append(format.types);
+        put(static_cast<uint32_t>(format.fmt.size()));
+        out_.append(format.fmt);
+    }
+}
+
+// 'E' entry whenever the clock has been calibrated, so the decompressor converts every tsc with the right parameters
+inline void TscLog::writeEpoch()
+{
+    TscParam param = get_param_();
+    if(param.base_tsc != last_param_.base_tsc)
+    {
+        out_.push_back('E');
+        put(param);
+        last_param_ = param;
+    }
+}
+
+inline void TscLog::flush()
+{
+    if(!out_.empty())
+    {
+        fwrite(out_.data(), 1, out_.size(), file_);
+        fflush(file_);
+        out_.clear();
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include "tsclog.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: tsclog_bench [threads] [logs_per_thread] [file]
+// Every thread logs as fast as it can, we measure the cost of a log call on the hot thread. The output can be read with
+// tsclog_decompress.
+
+static tscns::TSCNS<> tn;
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_tsclog_bench_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int nthreads = argc > 1 ? stoi(argv[1]) : 4;
+  const int N = argc > 2 ? stoi(argv[2]) : 1000000;
+  const char* path = argc > 3 ? argv[3] : "tsclog_bench.tlog";
+  tn.init();
+  auto& logger = tscns::TscLog::instance();
+  if (!logger.start(path, tn)) {
+    cerr << "failed to open " << path << endl;
+    return 1;
+  }
+  TSCLOG("tsclog_bench started with %d threads, %d logs each", nthreads, N);
+
+  vector<thread> thrs;
+  vector<double> latency(nthreads);
+  for (int t = 0; t < nthreads; t++) {
+    thrs.emplace_back([&, t]() {
+      const char* sides[] = {"buy", "sell"};
+      tscns::TscLog::preallocate();
+      int64_t t0 = tn.rdtsc();
+      for (int i = 0; i < N; i++) {
+        TSCLOG("thread %d order %d %s %.2f x %u", t, i, sides[i & 1], 100.0 + i * 0.01, (unsigned)(i % 100));
+        if ((i & 1023) == 0) {
+          // give the backend a chance to keep up, as a real application would between bursts
+          std::this_thread::yield();
+        }
+      }
+      int64_t t1 = tn.rdtsc();
+      latency[t] = (t1 - t0) / tn.getTscGhz() / N;
+    });
+  }
+  for (auto& thr : thrs) thr.join();
+  TSCLOG("tsclog_bench done");
+  logger.stop();
+
+  double total = 0;
+  for (double l : latency) total += l;
+  cout << std::setprecision(3) << fixed << "threads: " << nthreads << ", logs: " << (int64_t)nthreads * N
+       << ", log_latency: " << total / nthreads << ", dropped: " << logger.droppedLogs() << ", file: " << path << endl;
+
+  return 0;
+}
@@ -0,0 +1,286 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <ctime>
+#include "tsclog.hpp"
+#include "tsc_epochs.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: tsclog_decompress [-s] file.tlog
+// Renders a TscLog binary file as text, one line per log: time in ns, source location and the formatted message.
+// Timestamps are converted with the calibration parameters recorded in the file. -s sorts the logs of all threads by
+// time, otherwise they come in the order they were written.
+// A file cut short, e.g. by a crash, renders up to its last complete record, then fails with an error, as does a log
+// whose format wasn't recorded before it, or a format string with conversions that can't come from the logger.
+
+struct Format {
+  bool known = false;
+  string fmt;
+  string file;
+  uint32_t line;
+  string types;
+};
+
+struct Log {
+  uint32_t fmt_id;
+  int64_t tsc;
+  size_t args;
+  // offset of the arguments in the file
+  uint32_t args_size;
+};
+
+// Reads the file sequentially, every read failing without moving if the data left is too short
+class Reader {
+ public:
+  Reader(const vector<char>& data) : data_(data) {}
+  bool has(size_t n) const { return n <= data_.size() - pos_; }
+  template <typename T>
+  bool get(T& v) {
+    if (!has(sizeof(v))) return false;
+    memcpy(&v, data_.data() + pos_, sizeof(v));
+    pos_ += sizeof(v);
+    return true;
+  }
+  bool getString(string& s) {
+    uint32_t len;
+    if (!has(sizeof(len))) return false;
+    memcpy(&len, data_.data() + pos_, sizeof(len));
+    if (!has(sizeof(len) + (size_t)len)) return false;
+    s.assign(data_.data() + pos_ + sizeof(len), len);
+    pos_ += sizeof(len) + len;
+    return true;
+  }
+  size_t pos() const { return pos_; }
+  bool skip(size_t n) {
+    if (!has(n)) return false;
+    pos_ += n;
+    return true;
+  }
+
+ private:
+  const vector<char>& data_;
+  size_t pos_ = 0;
+};
+
+// local time of ts, or ts in ns if it's out of the range localtime() handles
+static string ptime(int64_t ts) {
+  char buf[64];
+  time_t sec = ts / 1000000000;
+  int64_t frac = ts % 1000000000;
+  if (frac < 0) {
+    // before 1970: round the seconds down so the fraction stays positive
+    frac += 1000000000;
+    sec--;
+  }
+  struct tm* dt = localtime(&sec);
+  if (!dt) return to_string(ts);
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S.", dt);
+  snprintf(buf + n, sizeof(buf) - n, "%09lld", (long long)frac);
+  return buf;
+}
+
+// Whether every conversion specifier of a format read from the file is one render() can feed on its own: no '*'
+// width or precision, which would read an argument snprintf() isn't given, and no 'n' or 'p'
+static bool validFormat(const string& fmt) {
+  for (size_t i = 0; i < fmt.size(); i++) {
+    if (fmt[i] != '%') continue;
+    size_t j = i + 1;
+    if (j < fmt.size() && fmt[j] == '%') {
+      i = j;
+      continue;
+    }
+    while (j < fmt.size() && strchr("-+ #0123456789.", fmt[j])) j++;
+    while (j < fmt.size() && strchr("hlLqjzt", fmt[j])) j++;
+    if (j >= fmt.size()) return true;
+    // an incomplete specifier at the end is rendered as text
+    if (!strchr("diouxXceEfFgGaAs", fmt[j])) return false;
+    i = j;
+  }
+  return true;
+}
+
+// Formats the message by feeding the conversion specifiers of the format string one at a time with the recorded
+// arguments, fixing up length modifiers to the types they were recorded as. Arguments are read up to end only.
+static string render(const Format& format, const char* args, const char* end) {
+  string out;
+  const string& fmt = format.fmt;
+  size_t arg = 0;
+  char buf[512];
+  for (size_t i = 0; i < fmt.size(); i++) {
+    if (fmt[i] != '%') {
+      out.push_back(fmt[i]);
+      continue;
+    }
+    if (i + 1 < fmt.size() && fmt[i + 1] == '%') {
+      out.push_back('%');
+      i++;
+      continue;
+    }
+    size_t j = i + 1;
+    string spec = "%";
+    while (j < fmt.size() && strchr("-+ #0123456789.", fmt[j])) spec.push_back(fmt[j++]);
+    while (j < fmt.size() && strchr("hlLqjzt", fmt[j])) j++;
+    if (j >= fmt.size() || arg >= format.types.size()) {
+      out.append(fmt, i, string::npos);
+      break;
+    }
+    char conv = fmt[j];
+    char type = format.types[arg++];
+    size_t left = end - args;
+    uint32_t len = 0;
+    if (type == 's' && left >= sizeof(len)) memcpy(&len, args, sizeof(len));
+    if (left < (type == 's' ? sizeof(len) + (size_t)len : sizeof(int64_t))) {
+      out.append("<arguments truncated>");
+      break;
+    }
+    if (type == 's') {
+      string s(args + sizeof(len), len);
+      args += sizeof(len) + len;
+      snprintf(buf, sizeof(buf), (spec + "s").c_str(), s.c_str());
+    }
+    else {
+      int64_t iv;
+      double dv;
+      memcpy(&iv, args, sizeof(iv));
+      memcpy(&dv, args, sizeof(dv));
+      args += sizeof(iv);
+      if (strchr("eEfFgGaA", conv)) {
+        snprintf(buf, sizeof(buf), (spec + conv).c_str(), type == 'd' ? dv : (double)iv);
+      }
+      else if (conv == 'c') {
+        snprintf(buf, sizeof(buf), (spec + conv).c_str(), (int)iv);
+      }
+      else {
+        long long v = type == 'd' ? (long long)dv : (long long)iv;
+        snprintf(buf, sizeof(buf), (spec + "ll" + (conv == 's' ? 'd' : conv)).c_str(), v);
+      }
+    }
+    out.append(buf);
+    i = j;
+  }
+  return out;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_tsclog_decompress_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  bool sort_logs = argc > 2 && strcmp(argv[1], "-s") == 0;
+  if (argc < 2) {
+    cerr << "usage: " << argv[0] << " [-s] file.tlog" << endl;
+    return 1;
+  }
+  ifstream in(argv[argc - 1], ios::binary);
+  vector<char> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  Reader r(data);
+  uint64_t magic;
+  if (!r.get(magic) || magic != tscns::TscLog::FileMagic) {
+    cerr << "not a TscLog file: " << argv[argc - 1] << endl;
+    return 1;
+  }
+
+  vector<Format> formats;
+  tscns::TscEpochs epochs;
+  vector<Log> logs;
+  string error;
+  // why the file couldn't be read to its end, the records before are still rendered
+  while (r.has(1) && error.empty()) {
+    size_t offset = r.pos();
+    char kind;
+    r.get(kind);
+    bool whole = true;
+    if (kind == 'F') {
+      uint32_t id;
+      Format format;
+      whole = r.get(id) && r.get(format.line) && r.getString(format.file) && r.getString(format.types) &&
+              r.getString(format.fmt);
+      if (whole && id >= data.size()) {
+        // ids are handed out in sequence: more ids than bytes in the file is corruption
+        error = "corrupted format id " + to_string(id) + " at offset " + to_string(offset);
+      }
+      else if (whole && !validFormat(format.fmt)) {
+        // the format strings drive snprintf(), only the conversions the logger records are let through
+        error = "corrupted format string at offset " + to_string(offset);
+      }
+      else if (whole) {
+        if (formats.size() <= id) formats.resize(id + 1);
+        format.known = true;
+        formats[id] = format;
+      }
+    }
+    else if (kind == 'E') {
+      tscns::TscParam param;
+      whole = r.get(param);
+      if (whole) epochs.add(param);
+    }
+    else if (kind == 'L') {
+      Log log;
+      whole = r.get(log.fmt_id) && r.get(log.tsc) && r.get(log.args_size);
+      log.args = r.pos();
+      whole = whole && r.skip(log.args_size);
+      if (whole && (log.fmt_id >= formats.size() || !formats[log.fmt_id].known)) {
+        error = "unknown format id " + to_string(log.fmt_id) + " at offset " + to_string(offset);
+      }
+      else if (whole) {
+        logs.push_back(log);
+      }
+    }
+    else {
+      error = "corrupted file at offset " + to_string(offset);
+    }
+    if (!whole) error = "file truncated in the record at offset " + to_string(offset);
+  }
+  if (epochs.empty()) {
+    if (!error.empty()) cerr << error << endl;
+    cerr << "no calibration parameters in the file" << endl;
+    return 1;
+  }
+
+  if (sort_logs) {
+    stable_sort(logs.begin(), logs.end(), [](const Log& a, const Log& b) { return a.tsc < b.tsc; });
+  }
+  for (auto& log : logs) {
+    const Format& format = formats[log.fmt_id];
+    const char* file = strrchr(format.file.c_str(), '/');
+    const char* args = data.data() + log.args;
+    cout << ptime(epochs.tsc2ns(log.tsc)) << ' ' << (file ? file + 1 : format.file.c_str()) << ':' << format.line
+         << ' ' << render(format, args, args + log.args_size) << '\n';
+  }
+  if (!error.empty()) {
+    cout.flush();
+    cerr << error << endl;
+    return 1;
+  }
+
+  return 0;
+}
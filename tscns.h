@@ -0,0 +1,230 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif !(defined(__i386__) || defined(__x86_64__) || defined(__aarch64__))
+#include <time.h>
+#endif
+
+// TSCNS_SEQLOCK_TSAN: detected as in seqlock.hpp, GCC defining __SANITIZE_THREAD__ and clang the thread_sanitizer
+// feature, so the readers below take the same fence-free variant as tscns::SeqLock under TSAN
+#ifndef TSCNS_SEQLOCK_TSAN
+#if defined(__SANITIZE_THREAD__)
+#define TSCNS_SEQLOCK_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define TSCNS_SEQLOCK_TSAN 1
+#endif
+#endif
+#endif
+#ifndef TSCNS_SEQLOCK_TSAN
+#define TSCNS_SEQLOCK_TSAN 0
+#endif
+
+// C interface to the process-wide clock of libtscns_global.so (tscns_global.hpp), for C code. The library initializes
+// and calibrates the clock; everything on the hot path is static inline here, reading the clock's parameters through
+// the same seqlock protocol as tscns::SeqLock, straight from the clock object the library exports.
+// The first tscns_rdns() initializes the clock with init()'s defaults (a 20 ms wait) unless tscns_global_init() was
+// called before; tscns_tsc2ns() and the batch conversion don't: make sure one of them came first.
+
+#ifndef TSCNS_GLOBAL_API
+#if defined(_MSC_VER)
+#ifdef TSCNS_GLOBAL_BUILD
+#define TSCNS_GLOBAL_API __declspec(dllexport)
+#else
+#define TSCNS_GLOBAL_API __declspec(dllimport)
+#endif
+#else
+#define TSCNS_GLOBAL_API __attribute__((visibility("default")))
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Layout of tscns::GlobalTSCNS up to what the readers use: SeqLock<Param, 0> (the sequence, then Param), then
+// next_calibrate_tsc_ and calibrate_interval_ns_. tscns_global.cc checks it at compile time.
+typedef struct tscns_clock
+{
+    uint32_t seq;
+    uint32_t seq_padding;
+    double ns_per_tsc;
+    int64_t base_tsc;
+    int64_t base_ns;
+    int64_t base_ns_err;
+    int64_t err_ns;
+    double err_rate;
+    int64_t interval_ns;
+    int64_t next_calibrate_tsc;
+    int64_t calibrate_interval_ns;
+} tscns_clock;
+
+// Same as tscns::TscParam: what tscns_tsc2ns() uses, valid until the next calibration
+typedef struct tscns_param
+{
+    int64_t base_tsc;
+    int64_t base_ns;
+    double ns_per_tsc;
+} tscns_param;
+
+TSCNS_GLOBAL_API bool tscns_global_init(int64_t init_calibrate_ns, int64_t calibrate_interval_ns);
+// Out of line part of tscns_rdns(): initializes the clock on first use, calibrates it when it's due
+TSCNS_GLOBAL_API void tscns_calibrate(void);
+
+#ifndef TSCNS_GLOBAL_BUILD
+// the library itself only needs the layout: it defines tscns_global_data as the GlobalTSCNS
+
+extern TSCNS_GLOBAL_API tscns_clock tscns_global_data;
+
+#if defined(_MSC_VER)
+#define TSCNS_C_UNLIKELY(x) (x)
+#define TSCNS_C_LOAD(field) (((volatile const tscns_clock *)&tscns_global_data)->field)
+// volatile loads are acquire loads with MSVC on x86/x64 (/volatile:ms), more than the protocol needs
+#else
+#define TSCNS_C_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define TSCNS_C_LOAD(field) tscns_load_##field()
+// relaxed atomic loads, as tscns::SeqLock's with TSCNS_SEQLOCK_ATOMIC
+#define TSCNS_C_DEFINE_LOAD(type, field)                                                                               \
+    static inline type tscns_load_##field(void)                                                                        \
+    {                                                                                                                  \
+        type value;                                                                                                    \
+        __atomic_load(&tscns_global_data.field, &value, __ATOMIC_RELAXED);                                             \
+        return value;                                                                                                  \
+    }
+TSCNS_C_DEFINE_LOAD(double, ns_per_tsc)
+TSCNS_C_DEFINE_LOAD(int64_t, base_tsc)
+TSCNS_C_DEFINE_LOAD(int64_t, base_ns)
+TSCNS_C_DEFINE_LOAD(int64_t, next_calibrate_tsc)
+#endif
+
+static inline int64_t tscns_rdtsc(void)
+{
+#ifdef _MSC_VER
+    return (int64_t)__rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+    return (int64_t)__builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t cntvct_el0;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r" (cntvct_el0));
+    return (int64_t)cntvct_el0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Reader side of tscns::SeqLock: the sequence, the fields, then the sequence again, retrying if a write was in progress
+// or happened meanwhile
+static inline uint32_t tscns_seq_begin(void)
+{
+#ifdef _MSC_VER
+    return *(volatile const uint32_t *)&tscns_global_data.seq & ~1u;
+#else
+    return __atomic_load_n(&tscns_global_data.seq, __ATOMIC_ACQUIRE) & ~1u;
+#endif
+}
+
+static inline bool tscns_seq_retry(uint32_t before_seq)
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+    return *(volatile const uint32_t *)&tscns_global_data.seq != before_seq;
+#elif TSCNS_SEQLOCK_TSAN
+    return __atomic_fetch_add(&tscns_global_data.seq, 0, __ATOMIC_RELEASE) != before_seq;
+    // as TSCNS_SEQLOCK_TSAN: no fence for TSAN
+#else
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&tscns_global_data.seq, __ATOMIC_RELAXED) != before_seq;
+#endif
+}
+
+static inline int64_t tscns_tsc2ns(int64_t tsc)
+{
+    int64_t ns;
+    uint32_t seq;
+    do
+    {
+        seq = tscns_seq_begin();
+        ns = TSCNS_C_LOAD(base_ns) + (int64_t)((tsc - TSCNS_C_LOAD(base_tsc)) * TSCNS_C_LOAD(ns_per_tsc));
+    } while(tscns_seq_retry(seq));
+    return ns;
+}
+
+static inline int64_t tscns_rdns(void)
+{
+    int64_t tsc = tscns_rdtsc();
+    if(TSCNS_C_UNLIKELY(tsc >= TSCNS_C_LOAD(next_calibrate_tsc)))
+    {
+        tscns_calibrate();
+    }
+    return tscns_tsc2ns(tsc);
+}
+
+static inline tscns_param tscns_get_param(void)
+{
+    tscns_param param;
+    uint32_t seq;
+    do
+    {
+        seq = tscns_seq_begin();
+        param.base_tsc = TSCNS_C_LOAD(base_tsc);
+        param.base_ns = TSCNS_C_LOAD(base_ns);
+        param.ns_per_tsc = TSCNS_C_LOAD(ns_per_tsc);
+    } while(tscns_seq_retry(seq));
+    return param;
+}
+
+static inline int64_t tscns_param_tsc2ns(const tscns_param * param, int64_t tsc)
+{
+    return param->base_ns + (int64_t)((tsc - param->base_tsc) * param->ns_per_tsc);
+}
+
+// Converts n tsc at once, with the parameters read once; tsc and ns can be the same array
+static inline void tscns_tsc2ns_batch(const int64_t * tsc, int64_t * ns, size_t n)
+{
+    tscns_param param = tscns_get_param();
+    for(size_t i = 0; i < n; i++)
+    {
+        ns[i] = tscns_param_tsc2ns(&param, tsc[i]);
+    }
+}
+
+static inline double tscns_get_tsc_ghz(void)
+{
+    return 1.0 / tscns_get_param().ns_per_tsc;
+}
+
+#endif // TSCNS_GLOBAL_BUILD
+
+#ifdef __cplusplus
+}
+#endif
@@ -27,32 +27,78 @@ SOFTWARE.
 #include <atomic>
 #include <thread>
 #include <array>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <utility>
+#include "seqlock.hpp"
 
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
-#ifdef _MSC_VER
-
-#define TSCNS_FORCE_INLINE __forceinline
+namespace tscns {
 
-#else //  _MSC_VER
+/**
+ * @brief A timestamp with its error bound: the true time is guaranteed to be within [earliest, latest],
+ * as long as the system clock TSCNS is synced with is right.
+ */
+struct TimeInterval
+{
+    int64_t earliest;
+    int64_t latest;
+};
 
-#if (defined(__GNUC__) && (__GNUC__ >= 4)) \
-    || (defined(__clang__) && (__clang_major__ >= 4)) \
-    || defined(__INTEL_COMPILER) \
-    || defined(__xlC__)
+/**
+ * @brief Snapshot of the parameters tsc2ns() uses, valid from base_tsc until the next calibration.
+ * Recording them along with raw tsc values lets tsc be converted later, even in another process.
+ */
+struct TscParam
+{
+    int64_t base_tsc;
+    int64_t base_ns;
+    double ns_per_tsc;
 
-#define TSCNS_FORCE_INLINE   __attribute__((always_inline)) inline
+    int64_t tsc2ns(int64_t tsc) const { return base_ns + static_cast<int64_t>((tsc - base_tsc) * ns_per_tsc); }
+};
 
-#else
+enum CalibKind : int32_t
+{
+    CalibInitBase = 0,
+    // first sample of init(), nothing saved yet
+    CalibInit = 1,
+    CalibCalibrate = 2,
+    CalibStep = 3,
+    // committed by calibrateStep()
+    CalibManual = 4,
+    // fed to calibrateWithSample() by the user, e.g. a replay
+};
 
-#define TSCNS_FORCE_INLINE
+/**
+ * @brief What a calibration saw and decided: the system clock sample it used, and the parameters it saved.
+ */
+struct CalibRecord
+{
+    int64_t kind;
+    int64_t tsc;
+    int64_t sys_ns;
+    int64_t bracket_tsc;
+    // sample: tsc and system clock read at the same time, within bracket_tsc
+    int64_t ns_err;
+    double ns_per_tsc;
+    int64_t calibrate_interval_ns;
+    // decision: the error found at the sample (unclamped, the correction saved is bounded to +-1 ms) and the new
+    // slope, see saveParam()
+};
 
-#endif
-#endif
+using CalibHook = void (*)(void * ctx, const CalibRecord & record);
 
-namespace tscns {
+// Whether event a surely happened before event b, i.e. their uncertainty intervals don't overlap.
+inline bool definitelyBefore(const TimeInterval & a, const TimeInterval & b)
+{
+    return a.latest < b.earliest;
+}
 
 /**
  * @brief A thread safe clock library to get the current timestamp at nanosecond precision and nanosecond latency.
@@ -63,46 +109,88 @@ namespace tscns {
  * It uses seqlock to ensure thread safety and it's SPMC.
  * (Producer : the thread calibrating the clock; Consumer : the thread reading the clock)
  * If we don't seperate calibrating and reading in different threads, we can further simplify this class.
+ *
+ * With kSelfCalibrate = true, rdns() checks whether calibration is due and, if so, the reader that wins the race
+ * on next_calibrate_tsc_ calibrates while the others carry on. No dedicated calibrating thread is needed then.
  */
-template <int32_t kCachelineSize = 64>
+template <int32_t kCachelineSize = 64, bool kSelfCalibrate = false>
 class TSCNS
 {
 public:
     void init(int64_t init_calibrate_ns = 20'000'000, int64_t calibrate_interval_ns = 3 * NsPerSec);
     void calibrate();
+    int32_t calibrateStep(int64_t max_sample_ns = 1'000);
+    void initWithSamples(int64_t calibrate_interval_ns, int64_t base_tsc, int64_t base_ns, int64_t base_bracket_tsc,
+                         int64_t delayed_tsc, int64_t delayed_ns, int64_t delayed_bracket_tsc);
+    void calibrateWithSample(int64_t tsc, int64_t ns, int64_t bracket_tsc, int32_t kind = CalibManual);
+    void setCalibHook(CalibHook hook, void * ctx);
     static int64_t rdtsc();
     int64_t tsc2ns(int64_t tsc) const;
     int64_t rdns() const;
+    TimeInterval tsc2nsBounded(int64_t tsc) const;
+    TimeInterval rdnsBounded() const;
+    int64_t sysOffset(int64_t tsc) const;
     static int64_t rdsysns();
     double getTscGhz() const;
+    TscParam getParam() const;
     static void syncTime(int64_t & tsc_out, int64_t & ns_out);
-    void saveParam(int64_t base_tsc, int64_t sys_ns, int64_t base_ns_err, double new_ns_per_tsc);
+    static void syncTime(int64_t & tsc_out, int64_t & ns_out, int64_t & bracket_tsc_out);
+    void saveParam(int64_t base_tsc, int64_t sys_ns, int64_t base_ns_err, double new_ns_per_tsc,
+                   int64_t err_ns = 0, double err_rate = MinDriftRate);
 
     static constexpr int64_t NsPerSec = 1'000'000'000;
-    alignas(kCachelineSize) std::atomic<uint32_t> param_seq_ {0};
-    // atomic sequence number implementing seqlock to ensure thread safety.
+    static constexpr bool SelfCalibrate = kSelfCalibrate;
+    // whether calibrations, and the calibration hook, can run in any rdns() caller
+    static constexpr int32_t CalibrateSteps = 3;
+    // number of good samples calibrateStep() collects before committing a calibration
+    static constexpr double MinDriftRate = 1e-6;
+    // lower bound of the error growth rate used by the bounded timestamps: 1 us per second
+    struct Param
+    {
+        double ns_per_tsc;
+        int64_t base_tsc;
+        int64_t base_ns;
+        int64_t base_ns_err;
+        int64_t err_ns;
+        double err_rate;
+        int64_t interval_ns;
+        // err_ns and err_rate are only used by the bounded timestamps, base_ns_err and interval_ns by sysOffset():
+        // the actual time since the previous calibration, which the slope spreads base_ns_err over
+    };
+    alignas(kCachelineSize) SeqLock<Param, 0> param_;
+    // the parameters behind the seqlock ensuring thread safety: the calibrating thread is the single writer.
     // align the cacheline to avoid false sharing
-    double ns_per_tsc_;
-    int64_t base_tsc_;
-    int64_t base_ns_;
+    std::atomic<int64_t> next_calibrate_tsc_;
+    // outside of the seqlock: it doubles as the try-lock electing the single calibrating thread
+    // starts the cacheline after param_, only read by rdns() of a self-calibrating clock
     int64_t calibrate_interval_ns_;
-    int64_t base_ns_err_;
-    int64_t next_calibrate_tsc_;
-    // These data members need not to be declared as atomic variables.  
-    // explicit memory fence will protect them
+    // set by init(), before readers come
 private:
-    std::array<uint8_t, kCachelineSize - (sizeof(param_seq_) + sizeof(ns_per_tsc_) + sizeof(base_tsc_) +
-        sizeof(base_ns_) + sizeof(calibrate_interval_ns_) + sizeof(base_ns_err_) + sizeof(next_calibrate_tsc_)) % kCachelineSize> padding_;
+    TSCNS_NOINLINE void selfCalibrate();
+    bool tryClaimCalibrate();
+    void record(int32_t kind, int64_t tsc, int64_t ns, int64_t bracket_tsc, int64_t ns_err, double ns_per_tsc);
+
+    std::array<uint8_t, kCachelineSize - (sizeof(param_) + sizeof(next_calibrate_tsc_) +
+        sizeof(calibrate_interval_ns_)) % kCachelineSize> padding_;
     // add padding here to prevent false sharing, i.e. we don't want another shared varaible 
     // to be stored in the same cacheline with these data memebers
+
+    int32_t step_samples_ = 0;
+    int64_t step_bracket_;
+    int64_t step_tsc_;
+    int64_t step_ns_;
+    // Samples collected so far by calibrateStep(), only touched by the calibrating thread
+
+    CalibHook calib_hook_ = nullptr;
+    void * calib_hook_ctx_ = nullptr;
+    // called by the calibrating thread on every calibration, outside of the seqlock
 };
 
-template <int32_t kCachelineSize>
-void TSCNS<kCachelineSize>::init(int64_t init_calibrate_ns, int64_t calibrate_interval_ns)
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::init(int64_t init_calibrate_ns, int64_t calibrate_interval_ns)
 {
-    calibrate_interval_ns_ = calibrate_interval_ns;
-    int64_t base_tsc, base_ns;
-    syncTime(base_tsc, base_ns);
+    int64_t base_tsc, base_ns, base_bracket;
+    syncTime(base_tsc, base_ns, base_bracket);
     // Get the baseline timestamp counter and system ns counter
     int64_t expire_ns = base_ns + init_calibrate_ns;
     while (rdsysns() < expire_ns) 
@@ -110,26 +198,110 @@ void TSCNS<kCachelineSize>::init(int64_t init_calibrate_ns, int64_t calibrate_in
         // wait for an interval
         std::this_thread::yield();
     }
-    int64_t delayed_tsc, delayed_ns;
-    syncTime(delayed_tsc, delayed_ns);
+    int64_t delayed_tsc, delayed_ns, delayed_bracket;
+    syncTime(delayed_tsc, delayed_ns, delayed_bracket);
     // Get the timestamp counter and system ns counter after an interval
+    initWithSamples(calibrate_interval_ns, base_tsc, base_ns, base_bracket, delayed_tsc, delayed_ns, delayed_bracket);
+}
+
+// The computation part of init(), with the two samples given, e.g. by a replay of recorded calibrations
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::initWithSamples(int64_t calibrate_interval_ns, int64_t base_tsc,
+                                                            int64_t base_ns, int64_t base_bracket_tsc,
+                                                            int64_t delayed_tsc, int64_t delayed_ns,
+                                                            int64_t delayed_bracket_tsc)
+{
+    calibrate_interval_ns_ = calibrate_interval_ns;
     double init_ns_per_tsc = static_cast<double>(delayed_ns - base_ns) / (delayed_tsc - base_tsc);
     // Compute the "ns_per_tsc" linearly
-    saveParam(base_tsc, base_ns, 0, init_ns_per_tsc);
+    int64_t err_ns = static_cast<int64_t>(base_bracket_tsc * init_ns_per_tsc / 2);
+    double err_rate = std::max((base_bracket_tsc + delayed_bracket_tsc) * init_ns_per_tsc / (delayed_ns - base_ns),
+                               MinDriftRate);
+    // Both samples can be off by half of their brackets, which also bounds the error of the slope
+    record(CalibInitBase, base_tsc, base_ns, base_bracket_tsc, 0, 0.0);
+    record(CalibInit, delayed_tsc, delayed_ns, delayed_bracket_tsc, 0, init_ns_per_tsc);
+    saveParam(base_tsc, base_ns, 0, init_ns_per_tsc, err_ns, err_rate);
     // save it to the class (error == 0)
 }
 
-template <int32_t kCachelineSize>
-void TSCNS<kCachelineSize>::calibrate()
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::calibrate()
 {
-    if(rdtsc() < next_calibrate_tsc_)
+    if(!tryClaimCalibrate())
     {
-        // no need to calibrate
+        // no need to calibrate, or another thread is calibrating
         return;
     }
-    int64_t tsc, ns;
-    syncTime(tsc, ns);
-    int64_t ns_err = tsc2ns(tsc) - ns;
+    int64_t tsc, ns, bracket;
+    syncTime(tsc, ns, bracket);
+    calibrateWithSample(tsc, ns, bracket, CalibCalibrate);
+}
+
+// Incremental calibrate() for threads that can't afford a whole syncTime() stall: each call takes at most one system
+// clock sample, drops it if it took longer than max_sample_ns, and commits the calibration once CalibrateSteps good
+// samples are collected. Returns the number of samples collected so far, CalibrateSteps on the committing call, 0 if no
+// calibration is due, or -1 if this call's sample was dropped (the samples collected before it are kept).
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+int32_t TSCNS<kCachelineSize, kSelfCalibrate>::calibrateStep(int64_t max_sample_ns)
+{
+    if(step_samples_ == 0 && rdtsc() < next_calibrate_tsc_.load(std::memory_order_relaxed))
+    {
+        // no need to calibrate
+        return 0;
+    }
+    // Take exactly one reference clock sample per call, the same way syncTime() does for each of its trials
+    int64_t tsc0 = rdtsc();
+    int64_t ns = rdsysns();
+    int64_t tsc1 = rdtsc();
+    int64_t bracket = tsc1 - tsc0;
+    if(bracket / getTscGhz() > max_sample_ns)
+    {
+        // we've been interrupted or the system clock is slow right now, the sample is useless
+        return -1;
+    }
+    if(step_samples_ == 0 || bracket < step_bracket_)
+    {
+        // keep the closest tsc pair
+        step_bracket_ = bracket;
+        step_tsc_ = (tsc0 + tsc1) >> 1;
+        step_ns_ = ns;
+    }
+    if(++step_samples_ < CalibrateSteps)
+    {
+        return step_samples_;
+    }
+    step_samples_ = 0;
+    if(!tryClaimCalibrate())
+    {
+        // another thread has calibrated in the meantime
+        return 0;
+    }
+    calibrateWithSample(step_tsc_, step_ns_, step_bracket_, CalibStep);
+    return CalibrateSteps;
+}
+
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+bool TSCNS<kCachelineSize, kSelfCalibrate>::tryClaimCalibrate()
+{
+    int64_t next_tsc = next_calibrate_tsc_.load(std::memory_order_relaxed);
+    if(rdtsc() < next_tsc)
+    {
+        return false;
+    }
+    // we own the parameters until saveParam() publishes the next calibration time
+    return next_calibrate_tsc_.compare_exchange_strong(next_tsc, std::numeric_limits<int64_t>::max(),
+                                                       std::memory_order_acquire);
+}
+
+// The computation part of calibrate(), with the sample given. Called directly (e.g. to replay recorded samples), it must
+// not race with another calibration.
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::calibrateWithSample(int64_t tsc, int64_t ns, int64_t bracket_tsc,
+                                                                int32_t kind)
+{
+    int64_t raw_ns_err = tsc2ns(tsc) - ns;
+    // the hook gets the error as found, only the correction below is bounded
+    int64_t ns_err = raw_ns_err;
     if(ns_err > 1'000'000)
     {
         ns_err = 1'000'000;
@@ -139,13 +311,41 @@ void TSCNS<kCachelineSize>::calibrate()
         ns_err = -1'000'000;
     }
     // avoid exception
-    double new_ns_per_tsc_ = ns_per_tsc_ * (1.0 - (ns_err + ns_err - base_ns_err_) / ((tsc - base_tsc_) * ns_per_tsc_));
-    // new_ns_per_tsc_ = ns_per_tsc_ - (ns_err + ns_err - base_ns_err_) / (tsc - base_tsc_)
-    saveParam(tsc, ns, ns_err, new_ns_per_tsc_);
+    const Param & param = param_.writerData();
+    // we own the calibration, nobody else writes the parameters
+    double new_ns_per_tsc_ = param.ns_per_tsc *
+        (1.0 - (ns_err + ns_err - param.base_ns_err) / ((tsc - param.base_tsc) * param.ns_per_tsc));
+    // new_ns_per_tsc_ = ns_per_tsc - (ns_err + ns_err - base_ns_err) / (tsc - base_tsc)
+    int64_t err_ns = std::abs(ns_err) + static_cast<int64_t>(bracket_tsc * new_ns_per_tsc_ / 2);
+    double err_rate = std::max(std::abs(new_ns_per_tsc_ - param.ns_per_tsc) / new_ns_per_tsc_, MinDriftRate);
+    // The new base is off by the error we've just measured plus the sampling uncertainty, and the clock can drift
+    // away at least as fast as the slope had to be corrected by
+    record(kind, tsc, ns, bracket_tsc, raw_ns_err, new_ns_per_tsc_);
+    // while we still own the calibration, so hooks are never called concurrently
+    saveParam(tsc, ns, ns_err, new_ns_per_tsc_, err_ns, err_rate);
+}
+
+// Have hook(ctx, record) called on every calibration, by the calibrating thread right before the new parameters are
+// saved. Set it before init() and before other threads start calibrating.
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::setCalibHook(CalibHook hook, void * ctx)
+{
+    calib_hook_ = hook;
+    calib_hook_ctx_ = ctx;
 }
 
-template <int32_t kCachelineSize>
-int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize>::rdtsc()
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::record(int32_t kind, int64_t tsc, int64_t ns, int64_t bracket_tsc,
+                                                   int64_t ns_err, double ns_per_tsc)
+{
+    if(calib_hook_)
+    {
+        calib_hook_(calib_hook_ctx_, CalibRecord {kind, tsc, ns, bracket_tsc, ns_err, ns_per_tsc, calibrate_interval_ns_});
+    }
+}
+
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::rdtsc()
 {
 #ifdef _MSC_VER
     return __rdtsc();
@@ -160,55 +360,100 @@ int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize>::rdtsc()
 #endif
 }
 
-template <int32_t kCachelineSize>
-int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize>::tsc2ns(int64_t tsc) const
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::tsc2ns(int64_t tsc) const
 {
-    int64_t ns;
-    uint32_t before_seq, after_seq;
-    do
+    return param_.read([tsc](const auto & p) {
+        return p(&Param::base_ns) + static_cast<int64_t>((tsc - p(&Param::base_tsc)) * p(&Param::ns_per_tsc));
+    });
+}
+
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::rdns() const
+{
+    int64_t tsc = rdtsc();
+    if constexpr(kSelfCalibrate)
     {
-        before_seq = param_seq_.load(std::memory_order_acquire) & ~1;
-        std::atomic_signal_fence(std::memory_order_acq_rel);
-        ns = base_ns_ + static_cast<int64_t>((tsc - base_tsc_) * ns_per_tsc_);
-        std::atomic_signal_fence(std::memory_order_acq_rel);
-        after_seq = param_seq_.load(std::memory_order_acquire);
-    } while(before_seq != after_seq);
-    return ns;
+        if(tsc >= next_calibrate_tsc_.load(std::memory_order_relaxed))
+        {
+            const_cast<TSCNS *>(this)->selfCalibrate();
+        }
+    }
+    return tsc2ns(tsc);
 }
-/* The code above is the same as 
-do 
+
+// Same as tsc2ns(), plus an error bound that starts from the uncertainty of the last calibration and grows with
+// the time elapsed since then.
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+TimeInterval TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::tsc2nsBounded(int64_t tsc) const
 {
-    uint32_t before_seq = param_seq_.load(std::memory_order_acquire);
-    std::atomic_signal_fence(std::memory_order_acq_rel);
-    int64_t ns = base_ns_ + static_cast<int64_t>((tsc - base_tsc_) * ns_per_tsc_);
-    std::atomic_signal_fence(std::memory_order_acq_rel);
-    uint32_t after_seq = param_seq_.load(std::memory_order_acquire);
-} while((seq0 != seq1) || (seq0 & 1));
-return ns;
-*/
+    int64_t ns, err;
+    std::tie(ns, err) = param_.read([tsc](const auto & p) {
+        double elapsed_ns = (tsc - p(&Param::base_tsc)) * p(&Param::ns_per_tsc);
+        return std::make_pair(p(&Param::base_ns) + static_cast<int64_t>(elapsed_ns),
+                              p(&Param::err_ns) + static_cast<int64_t>(std::abs(elapsed_ns) * p(&Param::err_rate)));
+    });
+    return {ns - err, ns + err};
+}
 
-template <int32_t kCachelineSize>
-int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize>::rdns() const
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+TimeInterval TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::rdnsBounded() const
 {
-    return tsc2ns(rdtsc());
+    return tsc2nsBounded(rdtsc());
 }
 
-template <int32_t kCachelineSize>
-int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize>::rdsysns()
+// Estimated tsc2ns(tsc) - system clock at tsc. A calibration doesn't make the clock jump: it starts from the offset
+// it has just measured (base_ns_err) and picks the slope that cancels it linearly over as long as the last interval
+// between calibrations actually lasted, provided the tsc rate drifts as it did during that one.
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+int64_t TSCNS<kCachelineSize, kSelfCalibrate>::sysOffset(int64_t tsc) const
+{
+    return param_.read([tsc](const auto & p) {
+        double elapsed_ns = (tsc - p(&Param::base_tsc)) * p(&Param::ns_per_tsc);
+        int64_t base_ns_err = p(&Param::base_ns_err);
+        return base_ns_err - static_cast<int64_t>(base_ns_err * elapsed_ns / p(&Param::interval_ns));
+    });
+}
+
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::selfCalibrate()
+{
+    // kept out of line so the not-due path of rdns() stays a single compare
+    calibrate();
+}
+
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+int64_t TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::rdsysns()
 {
     return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
-template <int32_t kCachelineSize>
-double TSCNS_FORCE_INLINE TSCNS<kCachelineSize>::getTscGhz() const
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+double TSCNS_FORCE_INLINE TSCNS<kCachelineSize, kSelfCalibrate>::getTscGhz() const
+{
+    return 1.0 / param_.read([](const auto & p) { return p(&Param::ns_per_tsc); });
+}
+
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+TscParam TSCNS<kCachelineSize, kSelfCalibrate>::getParam() const
 {
-    return 1.0 / ns_per_tsc_;
+    return param_.read([](const auto & p) {
+        return TscParam {p(&Param::base_tsc), p(&Param::base_ns), p(&Param::ns_per_tsc)};
+    });
 }
 
 // Linux kernel sync time by finding the first trial with tsc diff < 50000
 // We try several times and return the one with the mininum tsc diff.
-template <int32_t kCachelineSize>
-void TSCNS<kCachelineSize>::syncTime(int64_t & tsc_out, int64_t & ns_out)
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::syncTime(int64_t & tsc_out, int64_t & ns_out)
+{
+    int64_t bracket_tsc;
+    syncTime(tsc_out, ns_out, bracket_tsc);
+}
+
+// bracket_tsc_out is the tsc distance of the chosen pair: the system clock was read somewhere within it
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::syncTime(int64_t & tsc_out, int64_t & ns_out, int64_t & bracket_tsc_out)
 {
     // Try N = 3 times, find the closest tsc adjacent pair 
     // (meaning the CPU frequency does not change a lot within this interval)
@@ -233,24 +478,24 @@ void TSCNS<kCachelineSize>::syncTime(int64_t & tsc_out, int64_t & ns_out)
     }
     tsc_out = (tsc[best] + tsc[best - 1]) >> 1;
     ns_out = ns[best];
+    bracket_tsc_out = tsc[best] - tsc[best - 1];
 }
 
-template <int32_t kCachelineSize>
-void TSCNS<kCachelineSize>::saveParam(int64_t base_tsc, int64_t sys_ns, int64_t base_ns_err, double new_ns_per_tsc)
+template <int32_t kCachelineSize, bool kSelfCalibrate>
+void TSCNS<kCachelineSize, kSelfCalibrate>::saveParam(int64_t base_tsc, int64_t sys_ns, int64_t base_ns_err, double new_ns_per_tsc,
+                                                      int64_t err_ns, double err_rate)
 {
-    base_ns_err_ = base_ns_err;
-    // "tsc2ns" won't access "base_ns_err", no need to protect inside the memory barrier
-    next_calibrate_tsc_ = base_tsc + static_cast<int64_t>((calibrate_interval_ns_ - 1'000) / new_ns_per_tsc);
-    uint32_t seq = param_seq_.load(std::memory_order_relaxed);
-    param_seq_.store(++seq, std::memory_order_release);
-    std::atomic_signal_fence(std::memory_order_acq_rel);
-    base_tsc_ = base_tsc;
-    base_ns_ = sys_ns + base_ns_err;
-    ns_per_tsc_ = new_ns_per_tsc;
-    std::atomic_signal_fence(std::memory_order_acq_rel);
-    // Use memory fence here, protecting the stores of normal variables, while still allowing these normal
-    // stores to be reordered with each other for better performance.
-    param_seq_.store(++seq, std::memory_order_release);
+    const Param & prev = param_.writerData();
+    int64_t interval_ns = static_cast<int64_t>((base_tsc - prev.base_tsc) * prev.ns_per_tsc);
+    if(prev.ns_per_tsc == 0.0 || interval_ns <= 0)
+    {
+        // first parameters: nothing to spread yet
+        interval_ns = calibrate_interval_ns_;
+    }
+    param_.store(Param {new_ns_per_tsc, base_tsc, sys_ns + base_ns_err, base_ns_err, err_ns, err_rate, interval_ns});
+    next_calibrate_tsc_.store(base_tsc + static_cast<int64_t>((calibrate_interval_ns_ - 1'000) / new_ns_per_tsc),
+                              std::memory_order_release);
+    // Release the calibration try-lock last, so the next calibrating thread sees all of the above
 }
 
 }
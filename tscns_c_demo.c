@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tscns.h"
+
+#include "monolithic_examples.h"
+
+/* Usage: tscns_c_demo
+ * The C interface of tscns.h next to clock_gettime(CLOCK_REALTIME): the latency of both, the gap between them, and a
+ * batch conversion of recorded tsc. Fails if the clocks are more than 1 ms apart. */
+
+#define N 10000000
+#define BATCH 1024
+
+static int64_t realtime_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_c_demo_main
+#endif
+
+int main(int argc, const char** argv)
+{
+    (void)argc;
+    (void)argv;
+    tscns_global_init(20000000, 1000000000);
+
+    int64_t sum = 0;
+    int64_t begin = tscns_rdtsc();
+    for (int i = 0; i < N; i++) sum += tscns_rdns();
+    int64_t rdns_tsc = tscns_rdtsc() - begin;
+    begin = tscns_rdtsc();
+    for (int i = 0; i < N; i++) sum += realtime_ns();
+    int64_t realtime_tsc = tscns_rdtsc() - begin;
+    double tsc_ghz = tscns_get_tsc_ghz();
+    printf("tsc_ghz: %.6f, tscns_rdns: %.2f ns, clock_gettime: %.2f ns, (%lld)\n", tsc_ghz, rdns_tsc / tsc_ghz / N,
+           realtime_tsc / tsc_ghz / N, (long long)(sum & 1));
+
+    int64_t before = realtime_ns();
+    int64_t ns = tscns_rdns();
+    int64_t after = realtime_ns();
+    int64_t gap = ns < before ? ns - before : ns > after ? ns - after : 0;
+    printf("tscns_rdns - clock_gettime: %lld ns\n", (long long)gap);
+
+    static int64_t stamps[BATCH];
+    for (int i = 0; i < BATCH; i++) stamps[i] = tscns_rdtsc();
+    int64_t first = tscns_tsc2ns(stamps[0]);
+    int64_t last = tscns_tsc2ns(stamps[BATCH - 1]);
+    tscns_tsc2ns_batch(stamps, stamps, BATCH);
+    printf("batch of %d: first: %lld (tscns_tsc2ns: %lld), last: %lld (tscns_tsc2ns: %lld)\n", BATCH,
+           (long long)stamps[0], (long long)first, (long long)stamps[BATCH - 1], (long long)last);
+    return llabs(gap) > 1000000;
+}
@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define TSCNS_GLOBAL_BUILD
+#include <mutex>
+#include <cstddef>
+#include "tscns_global.hpp"
+#include "tscns.h"
+
+// Built as the libtscns_global shared object, see tscns_global.hpp, and tscns.h for C
+
+extern "C" {
+
+TSCNS_GLOBAL_API tscns::GlobalTSCNS tscns_global_data;
+// exported for the inline readers of tscns.h, which see it as a tscns_clock
+
+}
+
+namespace {
+
+using Param = tscns::GlobalTSCNS::Param;
+constexpr size_t ParamOffset = sizeof(tscns::SeqLock<Param, 0>) - sizeof(Param);
+// SeqLock<T, 0> is the sequence then the T, without padding after it
+static_assert(offsetof(tscns_clock, ns_per_tsc) == ParamOffset + offsetof(Param, ns_per_tsc), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, base_tsc) == ParamOffset + offsetof(Param, base_tsc), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, base_ns) == ParamOffset + offsetof(Param, base_ns), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, next_calibrate_tsc) == sizeof(tscns::SeqLock<Param, 0>), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, base_ns_err) == ParamOffset + offsetof(Param, base_ns_err), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, err_ns) == ParamOffset + offsetof(Param, err_ns), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, err_rate) == ParamOffset + offsetof(Param, err_rate), "tscns.h out of date");
+static_assert(offsetof(tscns_clock, interval_ns) == ParamOffset + offsetof(Param, interval_ns), "tscns.h out of date");
+static_assert(sizeof(tscns_clock::seq) == sizeof(std::atomic<uint32_t>) && std::atomic<uint32_t>::is_always_lock_free,
+              "tscns.h out of date");
+
+// and the clock itself: tscns.h reads tscns_global_data, a GlobalTSCNS, as a tscns_clock. GlobalTSCNS mixes public and
+// private members, which leaves offsetof() conditionally supported: GCC and clang support it, with a warning
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+#endif
+static_assert(offsetof(tscns::GlobalTSCNS, param_) == offsetof(tscns_clock, seq), "tscns.h out of date");
+static_assert(offsetof(tscns::GlobalTSCNS, next_calibrate_tsc_) == offsetof(tscns_clock, next_calibrate_tsc),
+              "tscns.h out of date");
+static_assert(offsetof(tscns::GlobalTSCNS, calibrate_interval_ns_) == offsetof(tscns_clock, calibrate_interval_ns),
+              "tscns.h out of date");
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+static_assert(sizeof(tscns::GlobalTSCNS) >= sizeof(tscns_clock), "tscns.h out of date");
+static_assert(alignof(tscns::GlobalTSCNS) % alignof(tscns_clock) == 0, "tscns.h out of date");
+
+std::mutex init_mutex;
+std::atomic<bool> initialized {false};
+
+}
+
+bool tscns_global_init(int64_t init_calibrate_ns, int64_t calibrate_interval_ns)
+{
+    std::lock_guard<std::mutex> lock(init_mutex);
+    if(initialized.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    tscns_global_data.init(init_calibrate_ns, calibrate_interval_ns);
+    initialized.store(true, std::memory_order_release);
+    // threads seeing it initialized without the lock see the parameters too
+    return true;
+}
+
+tscns::GlobalTSCNS * tscns_global_clock()
+{
+    if(!initialized.load(std::memory_order_acquire))
+    {
+        tscns_global_init(20'000'000, 3 * tscns::GlobalTSCNS::NsPerSec);
+        // the defaults of init(); a no-op if another thread has just done it
+    }
+    return &tscns_global_data;
+}
+
+void tscns_calibrate()
+{
+    if(!initialized.load(std::memory_order_acquire))
+    {
+        tscns_global_clock();
+        return;
+    }
+    tscns_global_data.calibrate();
+}
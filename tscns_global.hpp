@@ -0,0 +1,69 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include "tscns.hpp"
+
+// One clock for the whole process, shared by the executable and every shared library or plugin using it, with a single
+// init() wait and a single calibration. It lives in the tiny libtscns_global shared object, which the dynamic loader
+// maps once per process whatever the number of modules linked to it, RTLD_LOCAL plugins included; a static TSCNS or an
+// inline variable in a header would be duplicated in every module that's not loaded with RTLD_GLOBAL instead.
+// The clock calibrates itself (see kSelfCalibrate), so there's no calibrating thread to start or stop either.
+
+#if defined(_MSC_VER)
+#ifdef TSCNS_GLOBAL_BUILD
+#define TSCNS_GLOBAL_API __declspec(dllexport)
+#else
+#define TSCNS_GLOBAL_API __declspec(dllimport)
+#endif
+#else
+#define TSCNS_GLOBAL_API __attribute__((visibility("default")))
+#endif
+
+namespace tscns {
+
+using GlobalTSCNS = TSCNS<64, true>;
+
+}
+
+extern "C" {
+
+// Initializes the global clock with these settings instead of init()'s defaults. Only the first call (or first use of
+// the clock) initializes it: call it early in main() to choose the settings, it returns false if it's too late.
+TSCNS_GLOBAL_API bool tscns_global_init(int64_t init_calibrate_ns, int64_t calibrate_interval_ns);
+
+// The global clock, initialized with the defaults on the first call if tscns_global_init() wasn't called before
+TSCNS_GLOBAL_API tscns::GlobalTSCNS * tscns_global_clock();
+
+}
+
+namespace tscns {
+
+// The global clock, resolved once per module: after the first call it's a check of the static's guard
+inline GlobalTSCNS & globalClock()
+{
+    static GlobalTSCNS * clock = tscns_global_clock();
+    return *clock;
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include "tscns_global.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: tscns_global_demo [plugin.so...]
+// Loads the plugins (libtscns_global_plugin_a.so and _b.so by default) with RTLD_LOCAL, as plugin hosts do, and times
+// the first rdns() of each: only the first one waits for the init() of the global clock, the others find it ready.
+// Fails if the plugins and the executable don't all see the same clock.
+
+struct Plugin {
+  const void* (*clock)();
+  int64_t (*rdns)();
+};
+
+static bool load(const char* path, Plugin& plugin) {
+  void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    cerr << "dlopen " << path << ": " << dlerror() << endl;
+    return false;
+  }
+  plugin.clock = reinterpret_cast<const void* (*)()>(dlsym(handle, "plugin_clock"));
+  plugin.rdns = reinterpret_cast<int64_t (*)()>(dlsym(handle, "plugin_rdns"));
+  if (!plugin.clock || !plugin.rdns) {
+    cerr << path << " is not a plugin of this demo" << endl;
+    return false;
+  }
+  return true;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_global_demo_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  vector<string> paths;
+  for (int i = 1; i < argc; i++) paths.push_back(argv[i]);
+  if (paths.empty()) paths = {"./libtscns_global_plugin_a.so", "./libtscns_global_plugin_b.so"};
+
+  int failed = 0;
+  for (auto& path : paths) {
+    Plugin plugin;
+    if (!load(path.c_str(), plugin)) return 1;
+    int64_t begin = tscns::GlobalTSCNS::rdsysns();
+    int64_t ns = plugin.rdns();
+    int64_t first_call_ns = tscns::GlobalTSCNS::rdsysns() - begin;
+    bool same = plugin.clock() == &tscns::globalClock();
+    failed += !same;
+    cout << path << ": first rdns() took " << first_call_ns << " ns, rdns: " << ns
+         << (same ? ", same clock" : ", ANOTHER CLOCK") << endl;
+  }
+  cout << "executable: rdns: " << tscns::globalClock().rdns() << endl;
+  return failed ? 1 : 0;
+}
@@ -99,10 +99,11 @@ int main(int argc, const char** argv) {
     // calibrate_latency should not be a large value, especially not negative
     int64_t calibrate_latency = b - a - (int64_t)rdns_latency;
     int64_t rdsysns_latency = d - b - (int64_t)rdns_latency;
+    auto param = tn.param_.load();
     cout << "calibrate_latency: " << calibrate_latency << ", tsc_ghz: " << tn.getTscGhz()
          << ", b2c: " << b2c << ", c2d: " << c2d << ", err: " << err
          << ", rdsysns_latency: " << rdsysns_latency << ", tsc: " << tsc
-         << ", ns_per_tsc_: " << tn.ns_per_tsc_ << ", base_ns_err_: " << tn.base_ns_err_
+         << ", ns_per_tsc: " << param.ns_per_tsc << ", base_ns_err: " << param.base_ns_err
          << ", now: " << ptime(c) << endl;
     auto expire = tn.rdns() + tn.NsPerSec / 2;
     while (tn.rdns() < expire) std::this_thread::yield();
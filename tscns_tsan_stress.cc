@@ -0,0 +1,118 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include "tscns.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Usage: tscns_tsan_stress [seconds] [reader_threads] [broken]
+// Hammers every reader of TSCNS while it's being calibrated as often as possible, to be built with -fsanitize=thread
+// (see build.sh): TSAN must stay silent. __tsan_default_options() below sets halt_on_error, so the run stops with exit
+// code 66 on the first report (TSAN_OPTIONS still overrides it).
+// Two clocks are tested: one calibrated by a dedicated thread, and a self-calibrating one, calibrated by whichever
+// reader finds calibration due, so the calibration moves between threads.
+// "broken" is the negative control: the readers also copy the parameters bypassing the seqlock, the way code reading
+// the old public members did, and TSAN must report that race (exit code 66), showing the test can catch one.
+
+extern "C" const char* __tsan_default_options() { return "halt_on_error=1"; }
+
+static atomic<int64_t> calibrations{0};
+
+static void countCalib(void*, const tscns::CalibRecord&) { calibrations.fetch_add(1, memory_order_relaxed); }
+
+template <typename Clock>
+static int64_t readAll(const Clock& clock, int64_t& bad, bool broken) {
+  int64_t sum = clock.rdns();
+  if (broken) {
+    typename Clock::Param param = clock.param_.writerData();
+    sum += param.base_ns;
+  }
+  tscns::TimeInterval bounded = clock.rdnsBounded();
+  bad += bounded.earliest > bounded.latest;
+  tscns::TscParam param = clock.getParam();
+  sum += param.tsc2ns(Clock::rdtsc());
+  sum += clock.sysOffset(Clock::rdtsc());
+  double ghz = clock.getTscGhz();
+  bad += !(ghz > 0.01 && ghz < 100.0);
+  return sum;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_tsan_stress_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  int64_t seconds = argc > 1 ? stoll(argv[1]) : 5;
+  int nthreads = argc > 2 ? stoi(argv[2]) : max(2, (int)thread::hardware_concurrency() - 1);
+  bool broken = argc > 3 && string(argv[3]) == "broken";
+  cout << "TSCNS_SEQLOCK_ATOMIC: " << TSCNS_SEQLOCK_ATOMIC << ", TSCNS_SEQLOCK_TSAN: " << TSCNS_SEQLOCK_TSAN
+       << ", reader threads: " << nthreads << (broken ? ", broken" : "") << endl;
+
+  static tscns::TSCNS<> tn;
+  static tscns::TSCNS<64, true> self_tn;
+  tn.setCalibHook(countCalib, nullptr);
+  self_tn.setCalibHook(countCalib, nullptr);
+  tn.init(1'000'000, 100'000);
+  self_tn.init(1'000'000, 100'000);
+  // calibrate every 100 us, as often as a calibration can possibly overlap the readers
+
+  atomic<bool> running{true};
+  vector<int64_t> reads(nthreads), bad(nthreads), sums(nthreads);
+  vector<thread> readers;
+  for (int t = 0; t < nthreads; t++) {
+    readers.emplace_back([&, t]() {
+      while (running.load(memory_order_relaxed)) {
+        for (int i = 0; i < 256; i++) {
+          sums[t] += readAll(tn, bad[t], broken);
+          sums[t] += readAll(self_tn, bad[t], broken);
+        }
+        reads[t] += 256;
+      }
+    });
+  }
+  thread calibrator([&]() {
+    while (running.load(memory_order_relaxed)) {
+      tn.calibrate();
+    }
+  });
+
+  this_thread::sleep_for(chrono::seconds(seconds));
+  running = false;
+  calibrator.join();
+  int64_t total_reads = 0, total_bad = 0;
+  for (int t = 0; t < nthreads; t++) {
+    readers[t].join();
+    total_reads += reads[t];
+    total_bad += bad[t];
+  }
+  cout << "reads: " << total_reads << ", calibrations: " << calibrations.load() << ", bad values: " << total_bad
+       << endl;
+  return total_bad != 0;
+}
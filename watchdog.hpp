@@ -0,0 +1,192 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <cstring>
+#include "tscns.hpp"
+
+namespace tscns {
+
+/**
+ * @brief Heartbeat of a monitored thread, in a cacheline of its own so beating never contends with other threads.
+ * beat() is a rdtsc() and a relaxed store, cheap enough to be called on every iteration of a hot loop.
+ * idle() tells the watchdog the thread is expected to block for a while (e.g. waiting on a condition variable), so it's
+ * not reported as stalled until the next beat().
+ */
+template <typename Clock = TSCNS<>, int32_t kCachelineSize = 64>
+struct alignas(kCachelineSize) Heartbeat
+{
+    void beat() { tsc_.store(Clock::rdtsc(), std::memory_order_relaxed); }
+    void idle() { tsc_.store(0, std::memory_order_relaxed); }
+    int64_t last() const { return tsc_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> tsc_ {0};
+};
+
+struct StallRecord
+{
+    int32_t thread;
+    // id returned by registerThread()
+    int64_t beat_tsc;
+    // last heartbeat before the stall
+    int64_t beat_ns;
+    int64_t stall_ns;
+    // how long the thread has been stalled when detected, or the whole stall once it has ended, up to the beat that
+    // ended it
+    bool ended;
+    int64_t end_window_ns;
+    // ended stalls only: the thread came back within the last end_window_ns of stall_ns, after the last scan that still
+    // saw it stalled; at most a scan interval
+};
+
+/**
+ * @brief Detects threads not beating for longer than a threshold.
+ * Monitored threads call registerThread() once and then beat() their heartbeat; a monitor thread calls scan() (or
+ * run()) periodically, which reports each stall twice: when first detected, and with its full duration once the thread
+ * beats again. Beating stays a single store, so the monitor only knows the thread came back between two scans: the
+ * duration is up to the beat that ended it, with end_window_ns saying how much earlier it may have ended. Stalls
+ * shorter than the scan interval may be missed, so scan at least as often as the threshold.
+ */
+template <typename Clock = TSCNS<>, int32_t kMaxThreads = 64, int32_t kCachelineSize = 64>
+class Watchdog
+{
+public:
+    using HeartbeatType = Heartbeat<Clock, kCachelineSize>;
+    static constexpr int32_t MaxNameLen = 32;
+
+    Watchdog(const Clock & clock, int64_t threshold_ns);
+    int32_t registerThread(const char * name);
+    HeartbeatType & heartbeat(int32_t thread) { return heartbeats_[thread]; }
+    const char * name(int32_t thread) const { return states_[thread].name; }
+    template <typename F>
+    void scan(F && on_stall);
+    template <typename F>
+    void run(const std::atomic<bool> & running, F && on_stall, int64_t scan_interval_ns = 10'000);
+
+private:
+    struct ThreadState
+    {
+        char name[MaxNameLen];
+        int64_t stalled_beat;
+        // heartbeat we've reported as stalled, 0 if the thread is fine
+        int64_t stalled_seen;
+        // tsc of the last scan that still saw stalled_beat
+    };
+
+    const Clock & clock_;
+    int64_t threshold_ns_;
+    std::array<HeartbeatType, kMaxThreads> heartbeats_;
+    std::array<ThreadState, kMaxThreads> states_ {};
+    std::atomic<int32_t> next_id_ {0};
+    std::atomic<int32_t> registered_ {0};
+};
+
+template <typename Clock, int32_t kMaxThreads, int32_t kCachelineSize>
+Watchdog<Clock, kMaxThreads, kCachelineSize>::Watchdog(const Clock & clock, int64_t threshold_ns)
+    : clock_(clock)
+    , threshold_ns_(threshold_ns)
+{
+}
+
+// Returns the thread id to get the heartbeat with, or -1 if kMaxThreads are registered already.
+// The heartbeat starts idle: the thread is monitored from its first beat().
+template <typename Clock, int32_t kMaxThreads, int32_t kCachelineSize>
+int32_t Watchdog<Clock, kMaxThreads, kCachelineSize>::registerThread(const char * name)
+{
+    int32_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    if(id >= kMaxThreads)
+    {
+        return -1;
+    }
+    strncpy(states_[id].name, name, MaxNameLen - 1);
+    int32_t expected = id;
+    while(!registered_.compare_exchange_weak(expected, id + 1, std::memory_order_release))
+    {
+        // publish in order, so the monitor never sees a slot whose name isn't written yet
+        expected = id;
+    }
+    return id;
+}
+
+template <typename Clock, int32_t kMaxThreads, int32_t kCachelineSize>
+template <typename F>
+void Watchdog<Clock, kMaxThreads, kCachelineSize>::scan(F && on_stall)
+{
+    int32_t n = registered_.load(std::memory_order_acquire);
+    int64_t now = clock_.rdtsc();
+    for(int32_t i = 0; i < n; i++)
+    {
+        ThreadState & state = states_[i];
+        int64_t beat = heartbeats_[i].last();
+        if(state.stalled_beat && beat != state.stalled_beat)
+        {
+            // the thread is back: it came back after the last scan that saw it stalled, and by the beat we see now or
+            // now if it went idle
+            int64_t end = beat ? beat : now;
+            int64_t beat_ns = clock_.tsc2ns(state.stalled_beat);
+            int64_t end_ns = clock_.tsc2ns(end);
+            int64_t window_ns = std::max<int64_t>(end_ns - clock_.tsc2ns(state.stalled_seen), 0);
+            on_stall(StallRecord {i, state.stalled_beat, beat_ns, end_ns - beat_ns, true, window_ns});
+            state.stalled_beat = 0;
+        }
+        if(beat == 0)
+        {
+            continue;
+        }
+        if(beat == state.stalled_beat)
+        {
+            // reported already, still stalled
+            state.stalled_seen = now;
+            continue;
+        }
+        int64_t beat_ns = clock_.tsc2ns(beat);
+        int64_t stall_ns = clock_.tsc2ns(now) - beat_ns;
+        if(stall_ns > threshold_ns_)
+        {
+            on_stall(StallRecord {i, beat, beat_ns, stall_ns, false, 0});
+            state.stalled_beat = beat;
+            state.stalled_seen = now;
+        }
+    }
+}
+
+// Scan until running is cleared, pausing scan_interval_ns between scans
+template <typename Clock, int32_t kMaxThreads, int32_t kCachelineSize>
+template <typename F>
+void Watchdog<Clock, kMaxThreads, kCachelineSize>::run(const std::atomic<bool> & running, F && on_stall,
+                                                     int64_t scan_interval_ns)
+{
+    while(running.load(std::memory_order_relaxed))
+    {
+        scan(on_stall);
+        int64_t expire = clock_.rdns() + scan_interval_ns;
+        while(clock_.rdns() < expire)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+}
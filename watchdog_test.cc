@@ -0,0 +1,116 @@
+/*
+MIT License
+
+Copyright (c) 2022 Meng Rao <raomeng1@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <iostream>
+#include <vector>
+#include "replay_clock.hpp"
+#include "watchdog.hpp"
+
+#include "monolithic_examples.h"
+
+using namespace std;
+
+// Injects stalls of known length into a heartbeat under ReplayClock, scanning every 100 us as run() would, and checks
+// the durations the watchdog reports: the true one must lie within the end window of the ended record, itself no
+// longer than the scan interval.
+
+using Clock = tscns::ReplayClock;
+using Dog = tscns::Watchdog<Clock>;
+
+static constexpr int64_t Start = 1'700'000'000'000'000'000LL;
+static constexpr int64_t ScanInterval = 100'000;
+
+static int failures = 0;
+static int64_t now_ns = Start;
+
+// advance to ns, the thread beating every beat_ns (0 for not at all) and the watchdog scanning every ScanInterval
+static void runUntil(Dog& dog, tscns::Heartbeat<Clock>& hb, int64_t ns, int64_t beat_ns,
+                     vector<tscns::StallRecord>& out) {
+  int64_t next_scan = (now_ns / ScanInterval + 1) * ScanInterval;
+  while (now_ns < ns) {
+    int64_t step = beat_ns ? min(beat_ns, ns - now_ns) : ns - now_ns;
+    step = min(step, next_scan - now_ns);
+    now_ns += step;
+    Clock::setTime(now_ns);
+    if (beat_ns && now_ns % beat_ns == 0) hb.beat();
+    if (now_ns == next_scan) {
+      dog.scan([&](const tscns::StallRecord& r) { out.push_back(r); });
+      next_scan += ScanInterval;
+    }
+  }
+}
+
+static void expect(const char* what, const vector<tscns::StallRecord>& records, int64_t detected_min,
+                   int64_t detected_max, int64_t stall_ns) {
+  bool ok = records.size() == 2 && !records[0].ended && records[1].ended && records[0].stall_ns >= detected_min &&
+            records[0].stall_ns <= detected_max && records[1].stall_ns - records[1].end_window_ns < stall_ns &&
+            stall_ns <= records[1].stall_ns && records[1].end_window_ns <= ScanInterval;
+  cout << (ok ? "ok   " : "FAIL ") << what << ": records: " << records.size();
+  for (auto& r : records) {
+    cout << ", " << (r.ended ? "ended " : "detected ") << r.stall_ns << " ns";
+    if (r.ended) cout << " (window " << r.end_window_ns << " ns)";
+  }
+  cout << " (expected a stall of " << stall_ns << " ns)" << endl;
+  failures += !ok;
+}
+
+#if defined(BUILD_MONOLITHIC)
+#define main  tscns_watchdog_test_main
+#endif
+
+extern "C"
+int main(int argc, const char** argv) {
+  Clock clock;
+  Clock::setTime(now_ns);
+  Dog dog(clock, 1'000'000);
+  auto& hb = dog.heartbeat(dog.registerThread("worker"));
+  vector<tscns::StallRecord> records;
+
+  // beating every 10 us, then silent for 5.03 ms, then beating again for a while before the next scans
+  runUntil(dog, hb, Start + 10'000'000, 10'000, records);
+  int64_t stall_from = now_ns;
+  runUntil(dog, hb, stall_from + 5'030'000, 0, records);
+  hb.beat();
+  runUntil(dog, hb, now_ns + 1'000'000, 10'000, records);
+  expect("stall ended by a beat", records, 1'000'000, 1'000'000 + ScanInterval, 5'030'000);
+
+  // stalled 2.5 ms, then idle: the stall ends when the thread went idle
+  records.clear();
+  stall_from = now_ns;
+  runUntil(dog, hb, stall_from + 2'500'000, 0, records);
+  hb.idle();
+  runUntil(dog, hb, now_ns + 3'000'000, 0, records);
+  expect("stall ended by idle()", records, 1'000'000, 1'000'000 + ScanInterval, 2'500'000);
+
+  // idle doesn't count as a stall, the next one starts from the first beat after it
+  records.clear();
+  hb.beat();
+  stall_from = now_ns;
+  runUntil(dog, hb, stall_from + 1'234'567, 0, records);
+  hb.beat();
+  runUntil(dog, hb, now_ns + 500'000, 10'000, records);
+  expect("stall after idle", records, 1'000'000, 1'000'000 + ScanInterval, 1'234'567);
+
+  cout << (failures ? "failed" : "passed") << endl;
+  return failures != 0;
+}